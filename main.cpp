@@ -1,25 +1,56 @@
 #include "src/device_emulator/device_emulator.hpp"
-#include "src/device_emulator/helpers/getRandomData.h"
+#include "src/device_emulator/helpers/fastRandom.h"
 #include "src/research_tests/json_test.hpp"
-#include "src/server/clientList.h"
 #include "src/server/server.hpp"
+#include "src/server/serverOptions.h"
 
-std::vector<IClient> clientList;
-DevEmulator emulator;
+std::vector<std::unique_ptr<DevEmulator>> devices;
+CompressionPolicy compressionPolicy = CompressionPolicy::off;
+ISendQueueConfig sendQueueConfig;
 
 int main(int argc, char *argv[]) {
   //  json_test();
 
-  std::thread thrEmulator{&DevEmulator::run, std::ref(emulator)};
-
   // Check command line arguments.
-  if (argc != 5) {
-    std::cerr
-        << "Usage: emulator_server <address> <port> <doc_root> <threads>\n"
-        << "Example:\n"
-        << "    emulator_server 0.0.0.0 8080 ../client 1\n";
+  IServerOptions options;
+  std::string error;
+  if (argc < 5) {
+    logError("Usage: emulator_server <address> <port> <doc_root> "
+             "<threads> [options]\n",
+             serverOptionsUsage(), "Example:\n",
+             "    emulator_server 0.0.0.0 8080 ../client 1");
+    return EXIT_FAILURE;
+  }
+  if (!parseServerOptions(argc - 5, argv + 5, options, error)) {
+    logError(error, "\n", serverOptionsUsage());
+    return EXIT_FAILURE;
+  }
+  Logger::instance().setLevel(options.logLevel);
+  if (options.hasSeed)
+    FastRandom::setSeed(options.seed);
+  compressionPolicy = options.compression;
+  sendQueueConfig = options.sendQueue;
+  std::shared_ptr<const CaptureReader> replay;
+  std::unique_ptr<CaptureWriter> recorder;
+  try {
+    if (!options.replay.empty())
+      replay = std::make_shared<const CaptureReader>(options.replay);
+    if (!options.record.empty())
+      recorder = std::make_unique<CaptureWriter>(options.record);
+  } catch (const std::exception &e) {
+    logError(e.what());
     return EXIT_FAILURE;
   }
+
+  for (size_t i = 0; i < options.devices; i++) {
+    devices.push_back(std::make_unique<DevEmulator>(i, options.logCapacity));
+    devices.back()->setSignalConfig(options.signal);
+    if (replay)
+      devices.back()->setReplay(replay, options.replaySpeed);
+  }
+  if (recorder)
+    devices.front()->setRecorder(std::move(recorder));
+
   auto const address = net::ip::make_address(argv[1]);
   auto const port = static_cast<unsigned short>(std::atoi(argv[2]));
   auto const doc_root = std::make_shared<std::string>(argv[3]);
@@ -28,6 +59,11 @@ int main(int argc, char *argv[]) {
   // The io_context is required for all I/O
   net::io_context ioc{threads};
 
+  // The frames of every device are timed on the same io_context, each device
+  // on its own strand, so the devices are processed in parallel
+  for (auto &device : devices)
+    device->start(ioc, options.scheduler);
+
   // Create and launch a listening port
   std::make_shared<listener>(ioc, tcp::endpoint{address, port}, doc_root)
       ->run();
@@ -54,7 +90,8 @@ int main(int argc, char *argv[]) {
   for (auto &t : v)
     t.join();
 
-  thrEmulator.join();
+  for (auto &device : devices)
+    device->stop();
 
   return EXIT_SUCCESS;
 }
\ No newline at end of file
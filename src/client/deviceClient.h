@@ -0,0 +1,84 @@
+#pragma once
+
+#include "frameDecoder.h"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Blocking client of one emulated device, for analytics and load tests:
+//
+//   DeviceClient client;
+//   client.connect("127.0.0.1", "8080", "/device/1?batch");
+//   client.send(R"({"chartState":{"spectrumChan0":{"show":true}}})");
+//   while (client.read(onFrame, onText)) {}
+//
+// Errors of the connection are thrown as boost::system::system_error.
+class DeviceClient {
+public:
+  DeviceClient() : ws_{ioc_} {}
+
+  // `target` selects the device and may ask for the batch envelope.
+  // permessage-deflate is offered unless `deflate` is false.
+  void connect(const std::string &host, const std::string &port,
+               const std::string &target = "/", bool deflate = true) {
+    boost::asio::ip::tcp::resolver resolver{ioc_};
+    boost::asio::connect(ws_.next_layer(), resolver.resolve(host, port));
+    if (deflate) {
+      boost::beast::websocket::permessage_deflate options;
+      options.client_enable = true;
+      ws_.set_option(options);
+    }
+    ws_.handshake(host + ':' + port, target);
+  }
+
+  // Send a JSON request, such as {"chartState": ...} or {"deviceState": ...}
+  void send(std::string_view json) {
+    ws_.text(true);
+    ws_.write(boost::asio::buffer(json.data(), json.size()));
+  }
+
+  // Read one WebSocket message. Every channel message is passed to
+  // onFrame(const IFrameView &), the messages of a batch envelope one by
+  // one; JSON goes to onText(std::string_view). The views are valid until
+  // the next read. Returns false if a binary message could not be decoded.
+  template <typename OnFrame, typename OnText>
+  bool read(OnFrame &&onFrame, OnText &&onText) {
+    buffer_.clear();
+    ws_.read(buffer_);
+    auto data = static_cast<const char *>(buffer_.data().data());
+    size_t size = buffer_.size();
+    if (ws_.got_text()) {
+      onText(std::string_view{data, size});
+      return true;
+    }
+
+    auto decode = [&onFrame](const char *message, size_t messageSize) {
+      IFrameView frame;
+      if (!decodeFrame(message, messageSize, frame))
+        return false;
+      onFrame(static_cast<const IFrameView &>(frame));
+      return true;
+    };
+    if (size > 0 && static_cast<uint8_t>(data[0]) == 7) {
+      bool decoded = true;
+      bool valid = forEachBatchMessage(
+          data, size, [&](const char *message, size_t messageSize) {
+            decoded = decode(message, messageSize) && decoded;
+          });
+      return valid && decoded;
+    }
+    return decode(data, size);
+  }
+
+  void close() { ws_.close(boost::beast::websocket::close_code::normal); }
+
+private:
+  boost::asio::io_context ioc_;
+  boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws_;
+  boost::beast::flat_buffer buffer_;
+};
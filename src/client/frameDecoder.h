@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+
+// Decoder of the binary channel messages sent by the emulator (codes 0 to 6)
+// and of the batch envelope (code 7).
+//
+// Nothing is copied: the views point into the received message, which must
+// outlive them. Every size read from the message is checked against its
+// length before a view is made, so a truncated or corrupt message is
+// rejected instead of read past its end.
+
+// Array of numbers inside a received message. The elements of the packed
+// messages may be unaligned, so they are read with memcpy.
+template <typename T> class WireArray {
+  static_assert(std::is_arithmetic_v<T>, "WireArray: numbers only");
+
+public:
+  WireArray() = default;
+  WireArray(const char *data, size_t size) : data_{data}, size_{size} {}
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  // Raw little-endian bytes of the array, size() * sizeof(T) of them
+  const char *bytes() const { return data_; }
+
+  T operator[](size_t i) const {
+    T value;
+    std::memcpy(&value, data_ + i * sizeof(T), sizeof(T));
+    return value;
+  }
+
+  // Copy the elements to aligned storage of size() elements
+  void copyTo(T *out) const {
+    if (size_)
+      std::memcpy(out, data_, size_ * sizeof(T));
+  }
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+struct ISamplesView {
+  uint8_t code;              // 0 | 1, Номер канала
+  float timeStart;           // Начальное время, с
+  float timeStep;            // Шаг по времени, с
+  WireArray<int16_t> re;     // Re отсчёты
+  WireArray<int16_t> im;     // Im отсчёты
+  std::string_view metadata; // Метаданные, пустые если не запрошены
+};
+
+struct ISpectrumView {
+  uint8_t code;               // 2 | 3, Номер канала + 2
+  float fStart;               // Начальная частота, Гц
+  float fStep;                // Шаг по частоте, Гц
+  WireArray<int8_t> spectrum; // Спектр канала, дБ
+  std::string_view metadata;  // Метаданные, пустые если не запрошены
+};
+
+struct ICrossSpectrumView {
+  uint8_t code;               // 4
+  uint64_t date;              // Текущее время timeEPOX, мс
+  float fStart;               // Начальная частота, Гц
+  float fStep;                // Шаг по частоте, Гц
+  WireArray<int8_t> spectrum; // Взаимный спектр, дБ
+  std::string_view metadata;  // Метаданные
+};
+
+struct IPhaseSpectrumView {
+  uint8_t code;              // 5
+  float fStart;              // Начальная частота, Гц
+  float fStep;               // Шаг по частоте, Гц
+  WireArray<int16_t> phase;  // Фаза, град
+  std::string_view metadata; // Метаданные
+};
+
+struct IBearingView {
+  uint8_t code;                         // 6
+  float bearing;                        // Текущий пеленг, град
+  uint8_t bearingQuality;               // Качество пеленга, %
+  float bearingStd;                     // СКО пеленга, град
+  WireArray<int16_t> ampDistribution;   // Амплитуда, дБ
+  WireArray<int16_t> phaseDistribution; // Фаза, град
+  float beamPatternStep;                // Шаг по азимуту в ДНА, град
+  WireArray<float> beamPattern;         // ДНА, коэф. корр.
+  std::string_view metadata;            // Метаданные
+};
+
+using IFrameView = std::variant<ISamplesView, ISpectrumView,
+                                ICrossSpectrumView, IPhaseSpectrumView,
+                                IBearingView>;
+
+namespace frameDecoderDetail {
+
+// Sequential reader that fails once a read would pass the end
+class Cursor {
+public:
+  Cursor(const char *data, size_t size) : pos_{data}, end_{data + size} {}
+
+  bool ok() const { return pos_ != nullptr; }
+
+  template <typename T> T value() {
+    T result{};
+    if (take(sizeof(T)))
+      std::memcpy(&result, pos_ - sizeof(T), sizeof(T));
+    return result;
+  }
+
+  template <typename T> WireArray<T> array(size_t count) {
+    // Checked by division, so a huge count cannot overflow the product
+    if (!ok() || count > static_cast<size_t>(end_ - pos_) / sizeof(T)) {
+      pos_ = nullptr;
+      return {};
+    }
+    WireArray<T> result{pos_, count};
+    pos_ += count * sizeof(T);
+    return result;
+  }
+
+  // uint16 size followed by the UTF-8 string
+  std::string_view metadata() {
+    auto size = value<uint16_t>();
+    if (!take(size))
+      return {};
+    return {pos_ - size, size};
+  }
+
+  void skip(size_t size) { take(size); }
+
+private:
+  bool take(size_t size) {
+    if (!ok() || size > static_cast<size_t>(end_ - pos_)) {
+      pos_ = nullptr;
+      return false;
+    }
+    pos_ += size;
+    return true;
+  }
+
+  const char *pos_;
+  const char *end_;
+};
+
+} // namespace frameDecoderDetail
+
+// Decode one channel message. Returns false if the code is unknown or the
+// message is shorter than its sizes say; trailing bytes are not an error.
+inline bool decodeFrame(const char *data, size_t size, IFrameView &frame) {
+  frameDecoderDetail::Cursor in{data, size};
+  auto code = in.value<uint8_t>();
+  if (!in.ok())
+    return false;
+
+  switch (code) {
+  case 0:
+  case 1: {
+    ISamplesView view;
+    view.code = code;
+    view.timeStart = in.value<float>();
+    view.timeStep = in.value<float>();
+    auto sizeArray = in.value<uint16_t>();
+    in.skip(1);
+    view.re = in.array<int16_t>(sizeArray);
+    view.im = in.array<int16_t>(sizeArray);
+    view.metadata = in.metadata();
+    frame = view;
+    break;
+  }
+  case 2:
+  case 3: {
+    ISpectrumView view;
+    view.code = code;
+    view.fStart = in.value<float>();
+    view.fStep = in.value<float>();
+    view.spectrum = in.array<int8_t>(in.value<uint16_t>());
+    view.metadata = in.metadata();
+    frame = view;
+    break;
+  }
+  case 4: {
+    ICrossSpectrumView view;
+    view.code = code;
+    view.date = in.value<uint64_t>();
+    view.fStart = in.value<float>();
+    view.fStep = in.value<float>();
+    view.spectrum = in.array<int8_t>(in.value<uint16_t>());
+    view.metadata = in.metadata();
+    frame = view;
+    break;
+  }
+  case 5: {
+    IPhaseSpectrumView view;
+    view.code = code;
+    view.fStart = in.value<float>();
+    view.fStep = in.value<float>();
+    auto sizeArray = in.value<uint16_t>();
+    in.skip(1);
+    view.phase = in.array<int16_t>(sizeArray);
+    view.metadata = in.metadata();
+    frame = view;
+    break;
+  }
+  case 6: {
+    IBearingView view;
+    view.code = code;
+    view.bearing = in.value<float>();
+    view.bearingQuality = in.value<uint8_t>();
+    view.bearingStd = in.value<float>();
+    auto sizeDistribution = in.value<uint16_t>();
+    view.ampDistribution = in.array<int16_t>(sizeDistribution);
+    view.phaseDistribution = in.array<int16_t>(sizeDistribution);
+    view.beamPatternStep = in.value<float>();
+    auto sizeBeamPattern = in.value<uint16_t>();
+    in.skip(2);
+    view.beamPattern = in.array<float>(sizeBeamPattern);
+    view.metadata = in.metadata();
+    frame = view;
+    break;
+  }
+  default:
+    return false;
+  }
+  return in.ok();
+}
+
+// Call onMessage(data, size) for every message of a batch envelope. Returns
+// false if the envelope is malformed; the messages before the bad entry have
+// been passed on already.
+template <typename OnMessage>
+bool forEachBatchMessage(const char *data, size_t size, OnMessage onMessage) {
+  frameDecoderDetail::Cursor in{data, size};
+  if (in.value<uint8_t>() != 7)
+    return false;
+  auto count = in.value<uint8_t>();
+  in.skip(2);
+  for (size_t i = 0; in.ok() && i < count; i++) {
+    auto offset = in.value<uint32_t>();
+    auto length = in.value<uint32_t>();
+    if (!in.ok() || offset > size || length > size - offset)
+      return false;
+    onMessage(data + offset, size_t{length});
+  }
+  return in.ok();
+}
@@ -0,0 +1,101 @@
+#include "captureFile.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace bip = boost::interprocess;
+
+CaptureWriter::CaptureWriter(const std::string &path)
+    : capture_{path, std::ios::binary | std::ios::trunc},
+      index_{path + ".idx", std::ios::binary | std::ios::trunc},
+      offset_{kCaptureMagicSize} {
+  if (!capture_ || !index_)
+    throw std::runtime_error("CaptureWriter: cannot create '" + path + "'");
+  capture_.write(kCaptureMagic, kCaptureMagicSize);
+  index_.write(kCaptureIndexMagic, kCaptureMagicSize);
+}
+
+void CaptureWriter::append(bool isText, const char *data, size_t size) {
+  append(isText, {boost::asio::buffer(data, size)});
+}
+
+void CaptureWriter::append(
+    bool isText, const std::vector<boost::asio::const_buffer> &buffers) {
+  size_t size = boost::asio::buffer_size(buffers);
+  auto now = std::chrono::steady_clock::now();
+  if (!started_) {
+    started_ = true;
+    start_ = now;
+  }
+
+  ICaptureRecordHeader header{};
+  header.timeNs = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_)
+          .count());
+  header.size = static_cast<uint32_t>(size);
+  header.isText = isText;
+
+  ICaptureIndexEntry entry{};
+  entry.offset = offset_ + sizeof(header);
+  entry.timeNs = header.timeNs;
+  entry.size = header.size;
+  entry.isText = isText;
+
+  // Keep the next header 8-byte aligned in the mapped capture
+  static constexpr char padding[8] = {};
+  size_t padSize = (8 - size % 8) % 8;
+  capture_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (auto &buffer : buffers)
+    capture_.write(static_cast<const char *>(buffer.data()),
+                   static_cast<std::streamsize>(buffer.size()));
+  capture_.write(padding, static_cast<std::streamsize>(padSize));
+  offset_ += sizeof(header) + size + padSize;
+
+  // If the files are cut, the reader drops entries past the capture end
+  index_.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+}
+
+CaptureReader::CaptureReader(const std::string &path) {
+  try {
+    captureFile_ = bip::file_mapping(path.c_str(), bip::read_only);
+    capture_ = bip::mapped_region(captureFile_, bip::read_only);
+    indexFile_ = bip::file_mapping((path + ".idx").c_str(), bip::read_only);
+    index_ = bip::mapped_region(indexFile_, bip::read_only);
+  } catch (const bip::interprocess_exception &e) {
+    throw std::runtime_error("CaptureReader: cannot map '" + path +
+                             "': " + e.what());
+  }
+
+  auto captureData = static_cast<const char *>(capture_.get_address());
+  auto indexData = static_cast<const char *>(index_.get_address());
+  if (capture_.get_size() < kCaptureMagicSize ||
+      index_.get_size() < kCaptureMagicSize ||
+      std::memcmp(captureData, kCaptureMagic, kCaptureMagicSize) != 0 ||
+      std::memcmp(indexData, kCaptureIndexMagic, kCaptureMagicSize) != 0)
+    throw std::runtime_error("CaptureReader: '" + path +
+                             "' is not a capture");
+
+  // The mapping is page-aligned, so the entries after the magic are aligned
+  entries_ = reinterpret_cast<const ICaptureIndexEntry *>(indexData +
+                                                          kCaptureMagicSize);
+  count_ = (index_.get_size() - kCaptureMagicSize) / sizeof(ICaptureIndexEntry);
+
+  // Stop at the first record that is empty or not entirely in the capture:
+  // every message starts with its code
+  for (size_t i = 0; i < count_; i++) {
+    auto &entry = entries_[i];
+    if (entry.size == 0 || entry.offset > capture_.get_size() ||
+        entry.size > capture_.get_size() - entry.offset) {
+      count_ = i;
+      break;
+    }
+  }
+  if (count_ == 0)
+    throw std::runtime_error("CaptureReader: '" + path + "' is empty");
+}
+
+ICaptureRecord CaptureReader::record(size_t i) const {
+  auto &entry = entries_[i];
+  return {entry.timeNs, entry.isText != 0,
+          static_cast<const char *>(capture_.get_address()) + entry.offset,
+          entry.size};
+}
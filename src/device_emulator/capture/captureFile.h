@@ -0,0 +1,86 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Capture of the messages broadcast by a device.
+//
+// <path> holds the records: a fixed header followed by the serialized
+// message, padded to 8 bytes. <path>.idx is the sidecar index with one
+// entry per record, so the capture can be replayed without scanning it.
+// Both files are append-only; an index cut short by a crash still describes
+// a valid prefix of the capture.
+
+// Both files start with an 8-byte magic, without the terminating zero
+constexpr char kCaptureMagic[] = "DEVCAP01";
+constexpr char kCaptureIndexMagic[] = "DEVIDX01";
+constexpr size_t kCaptureMagicSize = 8;
+
+struct ICaptureRecordHeader {
+  uint64_t timeNs;   // Время от начала записи, нс
+  uint32_t size;     // Размер сообщения, байт
+  uint8_t isText;    // 1 - JSON, 0 - бинарное сообщение
+  uint8_t reserv[3]; // Выравнивание до 16 байт
+};
+static_assert(sizeof(ICaptureRecordHeader) == 16);
+
+struct ICaptureIndexEntry {
+  uint64_t offset; // Смещение сообщения в файле записи, байт
+  uint64_t timeNs; // Время от начала записи, нс
+  uint32_t size;   // Размер сообщения, байт
+  uint32_t isText; // 1 - JSON, 0 - бинарное сообщение
+};
+static_assert(sizeof(ICaptureIndexEntry) == 24);
+
+// One record of a mapped capture
+struct ICaptureRecord {
+  uint64_t timeNs;
+  bool isText;
+  const char *data;
+  size_t size;
+};
+
+// Appends messages to a new capture, replacing an existing one.
+// Not thread-safe: the caller serializes append().
+class CaptureWriter {
+public:
+  // Throws std::runtime_error if the files cannot be created
+  explicit CaptureWriter(const std::string &path);
+
+  void append(bool isText, const char *data, size_t size);
+  // Message made of several buffers, stored as one record
+  void append(bool isText,
+              const std::vector<boost::asio::const_buffer> &buffers);
+
+private:
+  std::ofstream capture_;
+  std::ofstream index_;
+  uint64_t offset_; // Size of the capture written so far
+  bool started_ = false;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Read-only memory-mapped capture, safe to share between threads
+class CaptureReader {
+public:
+  // Throws std::runtime_error if the capture is missing, empty or corrupt
+  explicit CaptureReader(const std::string &path);
+
+  size_t size() const { return count_; }
+  ICaptureRecord record(size_t i) const;
+
+private:
+  boost::interprocess::file_mapping captureFile_;
+  boost::interprocess::mapped_region capture_;
+  boost::interprocess::file_mapping indexFile_;
+  boost::interprocess::mapped_region index_;
+  const ICaptureIndexEntry *entries_;
+  size_t count_;
+};
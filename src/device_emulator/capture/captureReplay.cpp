@@ -0,0 +1,107 @@
+#include "captureReplay.h"
+#include "../../server/logger.h"
+#include <boost/asio/post.hpp>
+
+namespace net = boost::asio;
+
+namespace {
+
+// Records sent per handler at full speed, so that other handlers on the
+// io_context are not starved
+constexpr size_t kBatch = 64;
+// Poll interval while the clients are busy
+constexpr auto kBusyRetry = std::chrono::milliseconds(1);
+constexpr auto kReportInterval = std::chrono::seconds(10);
+
+} // namespace
+
+CaptureReplay::CaptureReplay(net::io_context &ioc,
+                             std::shared_ptr<const CaptureReader> capture,
+                             double speed, Sink sink, Busy busy)
+    : strand_{net::make_strand(ioc)}, timer_{strand_},
+      capture_{std::move(capture)}, speed_{speed}, sink_{std::move(sink)},
+      busy_{std::move(busy)} {}
+
+void CaptureReplay::start() {
+  net::post(strand_, [this] {
+    if (running_)
+      return;
+    running_ = true;
+    generation_ += 1;
+    // Shift the pass so that the next record is due now
+    auto recordTime = std::chrono::duration<double, std::nano>(
+        static_cast<double>(capture_->record(next_).timeNs) /
+        (speed_ > 0 ? speed_ : 1));
+    auto now = clock::now();
+    passStart_ = now - std::chrono::duration_cast<clock::duration>(recordTime);
+    reportStart_ = now;
+    reportRecords_ = 0;
+    reportBytes_ = 0;
+    wait(now);
+  });
+}
+
+void CaptureReplay::stop() {
+  net::post(strand_, [this] {
+    if (!running_)
+      return;
+    running_ = false;
+    generation_ += 1;
+    timer_.cancel();
+  });
+}
+
+void CaptureReplay::wait(clock::time_point time) {
+  timer_.expires_at(time);
+  timer_.async_wait([this, generation = generation_](
+                        const boost::system::error_code &ec) {
+    if (!ec)
+      step(generation);
+  });
+}
+
+void CaptureReplay::step(uint64_t generation) {
+  if (generation != generation_ || !running_)
+    return;
+
+  auto now = clock::now();
+  if (now - reportStart_ >= kReportInterval)
+    report(now);
+  if (busy_())
+    return wait(now + kBusyRetry);
+
+  for (size_t sent = 0; sent < kBatch; sent++) {
+    auto record = capture_->record(next_);
+    if (speed_ > 0) {
+      auto due = passStart_ + std::chrono::duration_cast<clock::duration>(
+                                  std::chrono::duration<double, std::nano>(
+                                      static_cast<double>(record.timeNs) /
+                                      speed_));
+      if (due > now)
+        return wait(due);
+    }
+
+    sink_(record);
+    reportRecords_ += 1;
+    reportBytes_ += record.size;
+    next_ += 1;
+    if (next_ == capture_->size()) {
+      // Start the next pass
+      next_ = 0;
+      passStart_ = now;
+      break;
+    }
+  }
+  wait(now);
+}
+
+void CaptureReplay::report(clock::time_point now) {
+  double seconds = std::chrono::duration<double>(now - reportStart_).count();
+  logInfo("CaptureReplay: ", reportRecords_, " records, ",
+          static_cast<double>(reportRecords_) / seconds, " msg/s, ",
+          static_cast<double>(reportBytes_) / 1e6 / seconds, " MB/s");
+
+  reportStart_ = now;
+  reportRecords_ = 0;
+  reportBytes_ = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "captureFile.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+// Streams the records of a capture on the io_context.
+//
+// At speed > 0 the records keep their recorded spacing divided by the speed;
+// at speed 0 they are sent as fast as the clients take them. The capture is
+// replayed in a loop, and the throughput is printed every 10 seconds.
+class CaptureReplay {
+public:
+  using clock = std::chrono::steady_clock;
+  // Send one record to the clients
+  using Sink = std::function<void(const ICaptureRecord &)>;
+  // True while the clients have too much queued to send more
+  using Busy = std::function<bool()>;
+
+  CaptureReplay(boost::asio::io_context &ioc,
+                std::shared_ptr<const CaptureReader> capture, double speed,
+                Sink sink, Busy busy);
+
+  // start() and stop() may be called from any thread. A restarted replay
+  // continues from the record where it stopped.
+  void start();
+  void stop();
+
+private:
+  void wait(clock::time_point time);
+  void step(uint64_t generation);
+  void report(clock::time_point now);
+
+private:
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+  boost::asio::steady_timer timer_;
+  std::shared_ptr<const CaptureReader> capture_;
+  double speed_;
+  Sink sink_;
+  Busy busy_;
+
+  // Only accessed on strand_
+  bool running_ = false;
+  uint64_t generation_ = 0; // Invalidates handlers of the previous start()
+  size_t next_ = 0;         // Next record to send
+  clock::time_point passStart_; // Time of record 0 in the current pass
+  clock::time_point reportStart_;
+  uint64_t reportRecords_ = 0;
+  uint64_t reportBytes_ = 0;
+};
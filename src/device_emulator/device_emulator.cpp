@@ -1,34 +1,138 @@
 #include "device_emulator.hpp"
-#include "../server/clientList.h"
+#include "../server/logger.h"
 #include "../server/server.hpp"
+#include "helpers/chartView.h"
 #include "helpers/getMetadata.h"
-#include "helpers/getRandomData.h"
+#include "helpers/fastRandom.h"
 #include "interfaces/IBinaryMsg.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 
-DevEmulator::DevEmulator() {
+namespace {
+
+// FFT sizes selected by IDeviceState::fftSizeIdx
+constexpr int kFftSizes[] = {128,  256,  512,   1024,  2048,
+                             4096, 8192, 16384, 32768, 65536};
+constexpr size_t kFftSizesCount = sizeof(kFftSizes) / sizeof(kFftSizes[0]);
+
+int fftSizeByIdx(uint8_t idx) {
+  return kFftSizes[std::min<size_t>(idx, kFftSizesCount - 1)];
+}
+
+// Chart of each binary message code
+constexpr IChart IChartState::*kChartByCode[] = {
+    &IChartState::samplesChan0,  &IChartState::samplesChan1,
+    &IChartState::spectrumChan0, &IChartState::spectrumChan1,
+    &IChartState::crossSpectrum, &IChartState::phaseSpectrum,
+    &IChartState::bearing};
+constexpr size_t kChartByCodeCount =
+    sizeof(kChartByCode) / sizeof(kChartByCode[0]);
+
+// Replay waits while a client has this many messages queued
+constexpr size_t kReplayMaxQueued = 64;
+
+// Device state in the log, serialized by the logger thread
+struct IDeviceStateLog {
+  IDeviceState state;
+};
+std::ostream &operator<<(std::ostream &os, const IDeviceStateLog &log) {
+  return os << json{{"deviceState", log.state}}.dump(4);
+}
+
+} // namespace
+
+DevEmulator *findDevice(std::string_view target) {
+  // Ignore the query string
+  target = target.substr(0, target.find('?'));
+  size_t index = 0;
+  if (target != "/") {
+    constexpr std::string_view prefix = "/device/";
+    if (target.substr(0, prefix.size()) != prefix)
+      return nullptr;
+    target.remove_prefix(prefix.size());
+    if (!target.empty() && target.back() == '/')
+      target.remove_suffix(1);
+    auto [end, ec] =
+        std::from_chars(target.data(), target.data() + target.size(), index);
+    if (ec != std::errc{} || end != target.data() + target.size() ||
+        target.empty())
+      return nullptr;
+  }
+  return index < devices.size() ? devices[index].get() : nullptr;
+}
+
+IConnectOptions parseConnectOptions(std::string_view target) {
+  IConnectOptions options;
+  auto query = target.find('?');
+  if (query == std::string_view::npos)
+    return options;
+  target.remove_prefix(query + 1);
+  while (!target.empty()) {
+    auto param = target.substr(0, target.find('&'));
+    if (param == "batch" || param == "batch=1" || param == "batch=true")
+      options.batch = true;
+    constexpr std::string_view logSince = "logSince=";
+    if (param.substr(0, logSince.size()) == logSince) {
+      auto value = param.substr(logSince.size());
+      uint64_t seq = 0;
+      auto [end, ec] =
+          std::from_chars(value.data(), value.data() + value.size(), seq);
+      if (ec == std::errc{} && end == value.data() + value.size())
+        options.logSince = seq;
+    }
+    target.remove_prefix(std::min(param.size() + 1, target.size()));
+  }
+  return options;
+}
+
+DevEmulator::DevEmulator(size_t index, size_t logCapacity)
+    : index_{index}, deviceLog_{logCapacity} {
   freqCenter_ = 1500e6;
   sampleRate_ = 61.44e6;
   dF_ = sampleRate_ / 2;
+  fftSize_ = kFftSizes[0];
+  updateAxes();
+
+  frame_ = 0;
+
+  IDeviceState state;
+  state.mode = DeviceMode::off;
+  state.shutdown = false;
+  state.freqCenter = freqCenter_;
+  state.sampleRateIdx = 0;
+  state.fftSizeIdx = 0;
+  state.gainChan0 = 12;
+  state.gainChan1 = 15;
+  deviceState_.store(state);
+}
+
+void DevEmulator::setSignalConfig(ISignalConfig config) {
+  cross_.setAveraging(config.crossAveraging);
+  // The average of the previous signal would leak into the new one
+  cross_.reset();
+  signal_.setConfig(std::move(config));
+}
+
+void DevEmulator::setRecorder(std::unique_ptr<CaptureWriter> recorder) {
+  recorder_ = std::move(recorder);
+}
+
+void DevEmulator::setReplay(std::shared_ptr<const CaptureReader> capture,
+                            double speed) {
+  replayCapture_ = std::move(capture);
+  replaySpeed_ = speed;
+}
+
+void DevEmulator::updateAxes() {
   fMin_ = freqCenter_ - dF_ / 2;
   fMax_ = freqCenter_ + dF_ / 2;
-
-  fftSize_ = 128;
   fStep_ = dF_ / static_cast<float>(fftSize_);
 
   timeStep_ = 1 / dF_;
   timeMin_ = 0.0;
   timeMax_ = timeStep_ * static_cast<float>(fftSize_);
 
-  frame_ = 0;
-
-  deviceState_.mode = DeviceMode::off;
-  deviceState_.shutdown = false;
-  deviceState_.freqCenter = freqCenter_;
-  deviceState_.sampleRateIdx = 0;
-  deviceState_.fftSizeIdx = 0;
-  deviceState_.gainChan0 = 12;
-  deviceState_.gainChan1 = 15;
-
   chartAxisLimits_.samplesChan0[0] = timeMin_;
   chartAxisLimits_.samplesChan0[1] = timeMax_;
   chartAxisLimits_.samplesChan1[0] = timeMin_;
@@ -39,194 +143,354 @@ DevEmulator::DevEmulator() {
   chartAxisLimits_.spectrumChan1[1] = fMax_;
   chartAxisLimits_.crossSpectrum[0] = fMin_;
   chartAxisLimits_.crossSpectrum[1] = fMax_;
+  updateSnapshot([this](ISnapshotState &snapshot) {
+    snapshot.chartAxisLimits = chartAxisLimits_;
+  });
 }
 
-void DevEmulator::setDeviceState(const json &data) {
-  std::lock_guard lock{mtx_};
-  data.get_to(deviceState_);
-  std::cout << "DevEmulator::setDeviceState: Получено новое состояние: "
-            << data.dump(4) << '\n';
+size_t DevEmulator::wireSize() const {
+  // sizeArray is uint16 on the wire and the arrays have even lengths, so at
+  // fftSize 65536 the last two points of every array are not transmitted
+  return std::min<size_t>(fftSize_, kMaxSizeArray);
+}
 
-  if (deviceState_.shutdown) {
-    std::cout << "DevEmulator::setDeviceState: Завершение работы" << '\n';
-    exit(0);
+void DevEmulator::processFrame(const IDeviceState &state) {
+  int fftSize = fftSizeByIdx(state.fftSizeIdx);
+  if (fftSize != fftSize_ || state.freqCenter != freqCenter_) {
+    fftSize_ = fftSize;
+    freqCenter_ = state.freqCenter;
+    updateAxes();
+    // The average would mix the spectra of two bands
+    cross_.reset();
+
+    broadcastText(json{{"chartAxisLimits", chartAxisLimits_}}.dump());
+  }
+  if (state.gainChan0 != gainChan0_ || state.gainChan1 != gainChan1_) {
+    gainChan0_ = state.gainChan0;
+    gainChan1_ = state.gainChan1;
+    cross_.reset();
   }
 
-  // Broadcast for all clients
-  auto str = json{{"deviceState", data}}.dump();
-  auto buff = std::make_shared<std::vector<char>>(str.begin(), str.end());
-  for (auto &client : clientList) {
-    client.ws->send(buff, buff->size(), true);
+  // Without a client showing a chart or a capture, the frame is not
+  // computed; frame_ still advances, so the bearing drift stays continuous
+  bool demanded = false;
+  for (auto chart : kChartByCode)
+    demanded = demanded || getDemand(chart).any();
+  if (!demanded) {
+    crossDemanded_ = false;
+    return;
   }
-}
 
-void DevEmulator::setChartState(const json &data, websocket_session *ws) {
-  std::lock_guard lock{mtx_};
-  std::cout << "DevEmulator::setChartState: Получено новое состояние: "
-            << data.dump(4) << '\n';
+  const float gainDb[SignalEngine::kChannels] = {
+      static_cast<float>(state.gainChan0), static_cast<float>(state.gainChan1)};
+  signal_.process(fftSize_, dF_, gainDb);
+
+  // The cross spectrum reuses the channel FFTs of this frame. After frames
+  // without it, the average restarts rather than resume from a stale one.
+  bool crossDemanded = getDemand(&IChartState::crossSpectrum).any() ||
+                       getDemand(&IChartState::phaseSpectrum).any();
+  if (crossDemanded && !crossDemanded_)
+    cross_.reset();
+  crossDemanded_ = crossDemanded;
+  if (crossDemanded)
+    cross_.process(signal_.channel(0), signal_.channel(1), signal_.refDb());
+
+  if (getDemand(&IChartState::bearing).any()) {
+    // The emulated source drifts slowly around 127.5 degrees
+    float sourceBearing =
+        127.5f + 4.5f * std::sin(0.02f * static_cast<float>(frame_));
+    // SNR of the strongest tone
+    auto &config = signal_.config();
+    float snrDb = 0;
+    for (auto &tone : config.tones)
+      snrDb = std::max(snrDb, tone.level - config.noiseLevel);
+
+    bearing_.setFreqCenter(freqCenter_);
+    bearing_.process(sourceBearing, snrDb);
+  }
+}
 
-  for (auto &client : clientList) {
-    if (client.ws == ws) {
-      data.get_to(client.chartState);
-      break;
+void DevEmulator::setDeviceState(const IDeviceStateUpdate &update) {
+  IDeviceState state;
+  {
+    // The update is merged into the current state
+    std::lock_guard lock{mtx_};
+    state = deviceState_.load();
+    update.applyTo(state);
+    deviceState_.store(state);
+    invalidateSnapshot();
+
+    if (state.shutdown) {
+      logInfo("DevEmulator::setDeviceState: Завершение работы");
+      // main() returns once the io threads have finished, so the logger
+      // writes out the remaining records after the last one has logged
+      ioc_->stop();
+      return;
     }
+    applyMode(state.mode);
   }
+
+  logInfo("DevEmulator ", index_,
+          "::setDeviceState: Получено новое состояние: ",
+          IDeviceStateLog{state});
+  broadcastText(json{{"deviceState", state}}.dump());
 }
 
-const IDeviceState &DevEmulator::getDeviceState() { return deviceState_; }
-const std::vector<IDeviceLogMsg> &DevEmulator::getDeviceLog() {
-  return deviceLog_;
+void DevEmulator::connectClient(const std::shared_ptr<websocket_session> &ws,
+                                uint64_t logSince) {
+  // Registered first, so the broadcasts from now on reach the session. It
+  // takes them from its inbox only after this call returns, on its strand,
+  // and writes the snapshot before them.
+  clients_.add(ws);
+  // The snapshot is shared with the other sessions, not serialized for each
+  // one
+  auto snapshot = connectSnapshot();
+  // A reconnecting client gets only the log entries it missed
+  auto deviceLog = logSince == 0 ? snapshot->deviceLog
+                                 : deviceLogSince(logSince, snapshot->logSeq);
+  ws->sendConnect(snapshot->message, deviceLog, snapshot->logSeq);
 }
-const IChartAxisLimits &DevEmulator::getChartAxisLimits() {
-  return chartAxisLimits_;
-};
 
-void DevEmulator::sendSamplesChan() const {
-  // Broadcast for all clients
-  for (auto &client : clientList) {
-    if (client.chartState.samplesChan0.show) {
-      ISamplesChan samplesChan0;
-      samplesChan0.code = 0;
-      samplesChan0.timeStart = timeMin_;
-      samplesChan0.timeStep = timeStep_;
-      samplesChan0.sizeArray = fftSize_;
-      samplesChan0.re = getRandomData<int16_t>(-1000, 1000, fftSize_);
-      samplesChan0.im = getRandomData<int16_t>(-1000, 1000, fftSize_);
-      if (client.chartState.samplesChan0.metadata) {
-        samplesChan0.metadata = getMetadata();
-      }
-      samplesChan0.sizeMetadata = samplesChan0.metadata.size();
+void DevEmulator::removeClient() {
+  // The expired entry is dropped from the next snapshot
+  clients_.remove();
+}
 
-      auto buffer1 =
-          std::make_shared<std::vector<char>>(samplesChan0.serialize());
-      client.ws->send(buffer1, buffer1->size(), false);
-    }
-    if (client.chartState.samplesChan1.show) {
-      ISamplesChan samplesChan1;
-      samplesChan1.code = 1;
-      samplesChan1.timeStart = timeMin_;
-      samplesChan1.timeStep = timeStep_;
-      samplesChan1.sizeArray = fftSize_;
-      samplesChan1.re = getRandomData<int16_t>(-500, 500, fftSize_);
-      samplesChan1.im = getRandomData<int16_t>(-500, 500, fftSize_);
-      if (client.chartState.samplesChan1.metadata) {
-        samplesChan1.metadata = getMetadata();
-      }
-      samplesChan1.sizeMetadata = samplesChan1.metadata.size();
+IDeviceState DevEmulator::getDeviceState() const {
+  return deviceState_.load();
+}
 
-      auto buffer2 =
-          std::make_shared<std::vector<char>>(samplesChan1.serialize());
-      client.ws->send(buffer2, buffer2->size(), false);
-    }
+template <typename Modify> void DevEmulator::updateSnapshot(Modify modify) {
+  std::lock_guard lock{snapshotMtx_};
+  modify(snapshotState_);
+  invalidateSnapshot();
+}
+
+void DevEmulator::invalidateSnapshot() {
+  snapshotVersion_.fetch_add(1, std::memory_order_release);
+}
+
+namespace {
+
+IBuffer deviceLogMessage(const std::vector<IDeviceLogMsg> &entries) {
+  auto str = json{{"deviceLog", entries}}.dump();
+  return std::make_shared<const std::vector<char>>(str.begin(), str.end());
+}
+
+} // namespace
+
+std::shared_ptr<const IConnectSnapshot> DevEmulator::connectSnapshot() {
+  // The first session after a change serializes the state, the rest of a
+  // reconnect storm share its buffer
+  std::lock_guard lock{snapshotMtx_};
+  // A change made while serializing bumps the version again, so the next
+  // session rebuilds the snapshot
+  auto version = snapshotVersion_.load(std::memory_order_acquire);
+  if (!snapshot_ || snapshot_->version != version) {
+    auto str = json{
+        {"deviceState", deviceState_.load()},
+        {"chartAxisLimits", snapshotState_.chartAxisLimits},
+    }.dump();
+    auto message = std::make_shared<const std::vector<char>>(str.begin(),
+                                                             str.end());
+    auto logSeq = deviceLog_.lastSeq();
+    snapshot_ = std::make_shared<const IConnectSnapshot>(
+        IConnectSnapshot{version, std::move(message),
+                         deviceLogMessage(deviceLog_.since(0, logSeq)),
+                         logSeq});
   }
-};
+  return snapshot_;
+}
+
+IBuffer DevEmulator::deviceLogSince(uint64_t seq, uint64_t last) const {
+  return deviceLogMessage(deviceLog_.since(seq, last));
+}
+
+std::unique_lock<std::mutex> DevEmulator::captureLock() {
+  if (!recorder_)
+    return {};
+  return std::unique_lock{sendMtx_};
+}
+
+void DevEmulator::broadcastText(const std::string &str, uint64_t logSeq) {
+  auto buff = std::make_shared<std::vector<char>>(str.begin(), str.end());
+  auto capture = captureLock();
+  if (recorder_)
+    recorder_->append(true, str.data(), str.size());
 
-void DevEmulator::sendSpectrumChan() const {
   // Broadcast for all clients
-  for (auto &client : clientList) {
-    if (client.chartState.spectrumChan0.show) {
-      ISpectrumChan spectrumChan0;
-      spectrumChan0.code = 2;
-      spectrumChan0.fStart = fMin_;
-      spectrumChan0.fStep = fStep_;
-      spectrumChan0.sizeArray = fftSize_;
-      spectrumChan0.spectrum = getRandomData<int8_t>(-10, 10, fftSize_);
-      if (client.chartState.spectrumChan0.metadata) {
-        spectrumChan0.metadata = getMetadata();
-      }
-      spectrumChan0.sizeMetadata = spectrumChan0.metadata.size();
+  auto message = makeGatherMessage(buff, buff->size());
+  auto clients = clients_.snapshot();
+  for (auto &weak : *clients) {
+    if (auto ws = weak.lock())
+      ws->send(message, true, logSeq);
+  }
+}
 
-      auto buffer1 =
-          std::make_shared<std::vector<char>>(spectrumChan0.serialize());
-      client.ws->send(buffer1, buffer1->size(), false);
+IDemand DevEmulator::getDemand(IChart IChartState::*chart) const {
+  IDemand demand;
+  // The capture gets every message, without metadata
+  demand.plain = recorder_ != nullptr;
+  for (auto &client : frameClients_) {
+    const IChart &state = client.chartState.*chart;
+    if (state.show) {
+      if (state.metadata)
+        demand.metadata = true;
+      else
+        demand.plain = true;
     }
-    if (client.chartState.spectrumChan1.show) {
-      ISpectrumChan spectrumChan1;
-      spectrumChan1.code = 3;
-      spectrumChan1.fStart = fMin_;
-      spectrumChan1.fStep = fStep_;
-      spectrumChan1.sizeArray = fftSize_;
-      spectrumChan1.spectrum = getRandomData<int8_t>(40, 50, fftSize_);
-      if (client.chartState.spectrumChan1.metadata) {
-        spectrumChan1.metadata = getMetadata();
-      }
-      spectrumChan1.sizeMetadata = spectrumChan1.metadata.size();
+  }
+  return demand;
+}
 
-      auto buffer2 =
-          std::make_shared<std::vector<char>>(spectrumChan1.serialize());
-      client.ws->send(buffer2, buffer2->size(), false);
-    }
+void DevEmulator::broadcast(const IFramePayload &payload,
+                            IChart IChartState::*chart) {
+  auto capture = captureLock();
+  if (recorder_)
+    recorder_->append(false, payload.plain.buffers);
+
+  // Broadcast for all subscribed clients
+  for (auto &client : frameClients_) {
+    const IChart &state = client.chartState.*chart;
+    if (state.show)
+      deliver(client, state.metadata ? payload.withMetadata : payload.plain);
   }
 }
 
-void DevEmulator::sendCrossSpectrum() const {
-  // Broadcast for all clients
-  for (auto &client : clientList) {
-    if (client.chartState.crossSpectrum.show) {
-      ICrossSpectrum crossSpectrum;
-      crossSpectrum.code = 4;
-      crossSpectrum.date = std::chrono::system_clock::now().time_since_epoch() /
-                           std::chrono::milliseconds(1);
-      crossSpectrum.fStart = fMin_;
-      crossSpectrum.fStep = fStep_;
-      crossSpectrum.sizeArray = fftSize_;
-      crossSpectrum.spectrum = getRandomData<int8_t>(-20, -10, fftSize_);
-      if (client.chartState.crossSpectrum.metadata) {
-        crossSpectrum.metadata = getMetadata();
-      }
-      crossSpectrum.sizeMetadata = crossSpectrum.metadata.size();
+void DevEmulator::deliver(IClient &client, const IGatherMessage &message) {
+  if (client.chartState.batch)
+    client.batch.push_back(message);
+  else
+    client.ws->send(message, false);
+}
 
-      auto buffer =
-          std::make_shared<std::vector<char>>(crossSpectrum.serialize());
-      client.ws->send(buffer, buffer->size(), false);
+void DevEmulator::flushBatches() {
+  for (auto &client : frameClients_) {
+    if (!client.batch.empty()) {
+      client.ws->send(makeBatchMessage(client.batch), false);
+      client.batch.clear();
     }
   }
 }
 
-void DevEmulator::sendPhaseSpectrum() const {
-  // Broadcast for all clients
-  for (auto &client : clientList) {
-    if (client.chartState.phaseSpectrum.show) {
-      IPhaseSpectrum phaseSpectrum;
-      phaseSpectrum.code = 5;
-      phaseSpectrum.fStart = fMin_;
-      phaseSpectrum.fStep = fStep_;
-      phaseSpectrum.sizeArray = fftSize_;
-      phaseSpectrum.phase = getRandomData<int16_t>(-180, 180, fftSize_);
-      if (client.chartState.phaseSpectrum.metadata) {
-        phaseSpectrum.metadata = getMetadata();
-      }
-      phaseSpectrum.sizeMetadata = phaseSpectrum.metadata.size();
+template <typename Encode>
+void DevEmulator::broadcastViews(uint8_t code, float start, float step,
+                                 Encode encode) {
+  auto variant = [&](const IChartView &view,
+                     bool metadata) -> const IGatherMessage & {
+    IVariantKey key{code, metadata, view};
+    return variants_.get(key, [&]() {
+      IDemand demand;
+      demand.plain = !metadata;
+      demand.metadata = metadata;
+      auto payload = encode(view, demand);
+      return metadata ? payload.withMetadata : payload.plain;
+    });
+  };
 
-      auto buffer =
-          std::make_shared<std::vector<char>>(phaseSpectrum.serialize());
-      client.ws->send(buffer, buffer->size(), false);
+  // The capture gets the whole array, without metadata
+  auto capture = captureLock();
+  if (recorder_) {
+    IChart wholeChart;
+    auto &message =
+        variant(makeChartView(wholeChart, start, step, wireSize()), false);
+    recorder_->append(false, message.buffers);
+  }
+
+  auto chart = kChartByCode[code];
+  for (auto &client : frameClients_) {
+    const IChart &state = client.chartState.*chart;
+    if (state.show) {
+      auto view = makeChartView(state, start, step, wireSize());
+      deliver(client, variant(view, state.metadata));
     }
   }
 }
 
-void DevEmulator::sendBearing() const {
-  // Broadcast for all clients
-  for (auto &client : clientList) {
+void DevEmulator::sendSamplesChan() {
+  for (int idx = 0; idx < SignalEngine::kChannels; idx++) {
+    auto &chan = signal_.channel(idx);
+    auto encode = [&](const IChartView &view, const IDemand &demand) {
+      ISamplesChan samplesChan;
+      samplesChan.code = static_cast<uint8_t>(idx);
+      samplesChan.timeStart = view.start;
+      samplesChan.timeStep = view.step;
+      samplesChan.sizeArray = static_cast<uint16_t>(view.size());
+      samplesChan.emptyByte = 0;
+      // The whole arrays are sent without copying
+      if (view.whole(wireSize()))
+        return makeSamplesPayload(samplesChan, chan.re, chan.im, demand,
+                                  getMetadata());
+      applyChartView(view, chan.re->data(), samplesChan.re);
+      applyChartView(view, chan.im->data(), samplesChan.im);
+      return makeFramePayload(samplesChan, demand, getMetadata());
+    };
+    broadcastViews(static_cast<uint8_t>(idx), timeMin_, timeStep_, encode);
+  }
+}
+
+void DevEmulator::sendSpectrumChan() {
+  for (int idx = 0; idx < SignalEngine::kChannels; idx++) {
+    auto &spectrum = signal_.channel(idx).spectrumDb;
+    auto encode = [&](const IChartView &view, const IDemand &demand) {
+      ISpectrumChan spectrumChan;
+      spectrumChan.code = static_cast<uint8_t>(2 + idx);
+      spectrumChan.fStart = view.start;
+      spectrumChan.fStep = view.step;
+      spectrumChan.sizeArray = static_cast<uint16_t>(view.size());
+      applyChartView(view, spectrum.data(), spectrumChan.spectrum);
+      return makeFramePayload(spectrumChan, demand, getMetadata());
+    };
+    broadcastViews(static_cast<uint8_t>(2 + idx), fMin_, fStep_, encode);
+  }
+}
+
+void DevEmulator::sendCrossSpectrum() {
+  auto date = std::chrono::system_clock::now().time_since_epoch() /
+              std::chrono::milliseconds(1);
+  auto encode = [&](const IChartView &view, const IDemand &demand) {
+    ICrossSpectrum crossSpectrum;
+    crossSpectrum.code = 4;
+    crossSpectrum.date = date;
+    crossSpectrum.fStart = view.start;
+    crossSpectrum.fStep = view.step;
+    crossSpectrum.sizeArray = static_cast<uint16_t>(view.size());
+    applyChartView(view, cross_.spectrumDb().data(), crossSpectrum.spectrum);
+    return makeFramePayload(crossSpectrum, demand, getMetadata());
+  };
+  broadcastViews(4, fMin_, fStep_, encode);
+}
+
+void DevEmulator::sendPhaseSpectrum() {
+  auto encode = [&](const IChartView &view, const IDemand &demand) {
+    IPhaseSpectrum phaseSpectrum;
+    phaseSpectrum.code = 5;
+    phaseSpectrum.fStart = view.start;
+    phaseSpectrum.fStep = view.step;
+    phaseSpectrum.sizeArray = static_cast<uint16_t>(view.size());
+    phaseSpectrum.emptyByte = 0;
+    applyChartView(view, cross_.phaseDeg().data(), phaseSpectrum.phase);
+    return makeFramePayload(phaseSpectrum, demand, getMetadata());
+  };
+  broadcastViews(5, fMin_, fStep_, encode);
+}
+
+void DevEmulator::sendBearing() {
+  auto demand = getDemand(&IChartState::bearing);
+  if (demand.any()) {
     IBearing bearing;
     bearing.code = 6;
-    bearing.bearing = getRandomData<float>(123, 132, 1)[0];
-    bearing.bearingQuality = getRandomData<uint8_t>(5, 100, 1)[0];
-    bearing.bearingStd = getRandomData<float>(3, 15, 1)[0];
-    bearing.sizeArrayDistribution = 7;
-    bearing.ampDistribution = getRandomData<int16_t>(-10, 10, 7);
-    bearing.phaseDistribution = getRandomData<int16_t>(-180, 180, 7);
-    bearing.beamPatternStep = 0.5;
-    bearing.sizeArrayBeamPattern = (uint16_t)(360. / bearing.beamPatternStep);
-    bearing.beamPattern =
-        getRandomData<float>(0.1, 1, bearing.sizeArrayBeamPattern);
-    if (client.chartState.bearing.metadata) {
-      bearing.metadata = getMetadata();
-    }
-    bearing.sizeMetadata = bearing.metadata.size();
-
-    auto buffer = std::make_shared<std::vector<char>>(bearing.serialize());
-    client.ws->send(buffer, buffer->size(), false);
+    bearing.bearing = bearing_.bearing();
+    bearing.bearingQuality = bearing_.quality();
+    bearing.bearingStd = bearing_.bearingStd();
+    bearing.sizeArrayDistribution = BearingEstimator::kElements;
+    bearing.ampDistribution = bearing_.ampDistribution();
+    bearing.phaseDistribution = bearing_.phaseDistribution();
+    bearing.beamPatternStep = BearingEstimator::kStep;
+    bearing.sizeArrayBeamPattern = BearingEstimator::kAzimuths;
+    bearing.beamPattern = bearing_.beamPattern();
+    broadcast(makeFramePayload(bearing, demand, getMetadata()),
+              &IChartState::bearing);
   }
 }
 
@@ -259,35 +523,152 @@ void DevEmulator::sendDeviceLog() {
           ". Обнаружитель: COM-порт не отвечает после десяти попыток запроса"};
   deviceLog.push_back(msg);
 
-  // Broadcast for all clients
-  auto str = json{{"deviceLog", deviceLog}}.dump();
-  auto buff = std::make_shared<std::vector<char>>(str.begin(), str.end());
-  for (auto &client : clientList) {
-    client.ws->send(buff, buff->size(), true);
+  // Only the new entries are broadcast, the clients append them to the log
+  // they have. The sequence numbers let a reconnecting client ask for the
+  // entries it missed. The entries are published together, so a connect
+  // snapshot has all of them or none.
+  deviceLog_.append(deviceLog);
+  invalidateSnapshot();
+  broadcastText(json{{"deviceLog", deviceLog}}.dump(), deviceLog.back().seq);
+}
+
+void DevEmulator::start(boost::asio::io_context &ioc,
+                        const ISchedulerConfig &config) {
+  ioc_ = &ioc;
+  if (replayCapture_) {
+    replay_ = std::make_unique<CaptureReplay>(
+        ioc, replayCapture_, replaySpeed_,
+        [this](const ICaptureRecord &record) { sendRecord(record); },
+        [this] { return clientsBusy(); });
+  } else {
+    scheduler_ = std::make_unique<FrameScheduler>(ioc, [this] { tick(); });
+    scheduler_->setConfig(config);
+    lastReport_ = FrameScheduler::clock::now();
   }
 
-  deviceLog_ = std::move(deviceLog);
+  std::lock_guard lock{mtx_};
+  applyMode(deviceState_.load().mode);
 }
 
-void DevEmulator::run() {
-  std::cout << "DevEmulator TID: " << std::this_thread::get_id()
-            << " started\n";
+void DevEmulator::stop() {
+  scheduler_.reset();
+  replay_.reset();
+  recorder_.reset();
+}
 
-  while (!deviceState_.shutdown) {
-    if (deviceState_.mode != DeviceMode::off) {
-      sendSamplesChan();
-      sendSpectrumChan();
-      sendCrossSpectrum();
-      sendPhaseSpectrum();
-      sendBearing();
+void DevEmulator::applyMode(DeviceMode mode) {
+  if (mode != DeviceMode::off) {
+    if (scheduler_)
+      scheduler_->start();
+    if (replay_)
+      replay_->start();
+  } else {
+    if (scheduler_)
+      scheduler_->stop();
+    if (replay_)
+      replay_->stop();
+  }
+}
 
-      frame_ += 1;
-      if (frame_ % 50 == 0) {
-        sendDeviceLog();
+void DevEmulator::sendRecord(const ICaptureRecord &record) {
+  if (record.size == 0)
+    return;
+
+  // The clients are sent the mapped capture itself, which the message keeps
+  // mapped until every session has written it
+  IGatherMessage message{replayCapture_,
+                         {boost::asio::buffer(record.data, record.size)}};
+  auto code = static_cast<uint8_t>(record.data[0]);
+
+  auto clients = clients_.snapshot();
+  for (auto &weak : *clients) {
+    auto ws = weak.lock();
+    if (!ws)
+      continue;
+    if (!record.isText) {
+      if (code >= kChartByCodeCount ||
+          !(ws->chartState().load().*kChartByCode[code]).show)
+        continue;
+    }
+    ws->send(message, record.isText);
+  }
+}
+
+bool DevEmulator::clientsBusy() {
+  auto clients = clients_.snapshot();
+  for (auto &weak : *clients) {
+    auto ws = weak.lock();
+    if (ws && ws->queued() >= std::min(kReplayMaxQueued,
+                                       sendQueueConfig.capacity / 2))
+      return true;
+  }
+  return false;
+}
+
+void DevEmulator::tick() {
+  auto state = deviceState_.load();
+
+  // The whole frame uses one snapshot of the clients and their chart states.
+  // The registry snapshot is let go once the sessions are copied.
+  frameClients_.clear();
+  {
+    auto clients = clients_.snapshot();
+    for (auto &weak : *clients) {
+      if (auto ws = weak.lock()) {
+        IClient client;
+        client.chartState = ws->chartState().load();
+        client.ws = std::move(ws);
+        frameClients_.push_back(std::move(client));
       }
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-  };
+  }
+
+  processFrame(state);
+  sendSamplesChan();
+  sendSpectrumChan();
+  sendCrossSpectrum();
+  sendPhaseSpectrum();
+  sendBearing();
+  flushBatches();
+  variants_.clear();
+  // The sessions closed during the frame are released here
+  frameClients_.clear();
+
+  frame_ += 1;
+  if (frame_ % 50 == 0) {
+    sendDeviceLog();
+  }
+
+  // Scheduler statistics every 10 seconds
+  auto now = FrameScheduler::clock::now();
+  if (now - lastReport_ >= std::chrono::seconds(10)) {
+    lastReport_ = now;
+    auto stats = scheduler_->stats();
+    logInfo("DevEmulator ", index_, ": frames ", stats.frames, ", late ",
+            stats.lateFrames, ", skipped ", stats.skippedFrames,
+            ", jitter mean ", stats.jitterMeanUs, " us, max ",
+            stats.jitterMaxUs, " us");
+    auto cache = variants_.stats();
+    logInfo("DevEmulator ", index_, ": variant cache hits ", cache.hits,
+            ", misses ", cache.misses);
+    // Wait of the text messages behind the frames, over the connected
+    // clients
+    IControlWaitStats wait;
+    double waitSumMs = 0;
+    auto clients = clients_.snapshot();
+    for (auto &weak : *clients) {
+      if (auto ws = weak.lock()) {
+        auto client = ws->controlWait();
+        wait.messages += client.messages;
+        waitSumMs += client.meanMs * static_cast<double>(client.messages);
+        wait.maxMs = std::max(wait.maxMs, client.maxMs);
+      }
+    }
+    if (wait.messages)
+      wait.meanMs = waitSumMs / static_cast<double>(wait.messages);
+    logInfo("DevEmulator ", index_, ": text messages ", wait.messages,
+            ", wait mean ", wait.meanMs, " ms, max ", wait.maxMs, " ms");
+  }
 }
 
 //  // ============================================
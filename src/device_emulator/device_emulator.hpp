@@ -1,11 +1,27 @@
 #pragma once
 
+#include "../server/clientList.h"
+#include "../server/clientRegistry.h"
+#include "capture/captureFile.h"
+#include "capture/captureReplay.h"
+#include "dsp/bearingEstimator.h"
+#include "dsp/crossSpectrum.h"
+#include "dsp/signalEngine.h"
+#include "frameScheduler.h"
+#include "helpers/framePayload.h"
+#include "helpers/logRing.h"
+#include "helpers/seqlock.h"
+#include "helpers/variantCache.h"
 #include "interfaces/IJsonMsg.h"
+#include "interfaces/controlMsg.h"
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <variant>
@@ -15,27 +31,122 @@ using json = nlohmann::json;
 
 class websocket_session;
 
+// Messages sent to a client on connection. Shared by every session that
+// connects until the state changes.
+struct IConnectSnapshot {
+  uint64_t version;  // Номер изменения состояния
+  IBuffer message;   // JSON: deviceState и chartAxisLimits
+  IBuffer deviceLog; // JSON: deviceLog, все записи журнала в памяти
+  uint64_t logSeq;   // Последняя запись журнала в deviceLog
+};
+
+// Parameters of the query string of the WebSocket URL
+struct IConnectOptions {
+  // "batch", "batch=1" or "batch=true": frames in batch envelopes from the
+  // start
+  bool batch = false;
+  // "logSince=<seq>": send only the log entries after seq on connection
+  uint64_t logSince = 0;
+};
+
 class DevEmulator {
 public:
-  DevEmulator();
-  void run();
-  void setDeviceState(const json &data);
-  void setChartState(const json &data, websocket_session *ws);
-  const IDeviceState &getDeviceState();
-  const std::vector<IDeviceLogMsg> &getDeviceLog();
-  const IChartAxisLimits &getChartAxisLimits();
+  // The device log keeps the last `logCapacity` entries for the clients
+  // that connect later
+  DevEmulator(size_t index, size_t logCapacity);
+  void setSignalConfig(ISignalConfig config);
+  // Append everything broadcast by the device to a capture. Called before
+  // start().
+  void setRecorder(std::unique_ptr<CaptureWriter> recorder);
+  // Stream a capture instead of generating frames. Speed 0 replays as fast
+  // as the clients take the messages.
+  void setReplay(std::shared_ptr<const CaptureReader> capture, double speed);
+  // Produce the frames on the io_context while the device mode is not off
+  void start(boost::asio::io_context &ioc, const ISchedulerConfig &config);
+  // Release the timers before the io_context is destroyed and finish the
+  // capture. Called after the io threads have finished.
+  void stop();
+  // Merge the update into the device state and send the result to the
+  // clients
+  void setDeviceState(const IDeviceStateUpdate &update);
+  // Subscribe a session to the frames of this device, then send it the
+  // connect snapshot, with the log entries after `logSince` if it is not 0.
+  // The device holds the session by weak_ptr and reads the chart state it
+  // publishes. Called on the strand of the session.
+  void connectClient(const std::shared_ptr<websocket_session> &ws,
+                     uint64_t logSince);
+  // Called by a destroyed session
+  void removeClient();
+  IDeviceState getDeviceState() const;
+  // Snapshot of the current state, serialized again only after a change
+  std::shared_ptr<const IConnectSnapshot> connectSnapshot();
+  // {"deviceLog": [...]} with the entries after `seq` up to `last` still in
+  // memory
+  IBuffer deviceLogSince(uint64_t seq, uint64_t last) const;
 
 private:
-  void sendSamplesChan() const;
-  void sendSpectrumChan() const;
-  void sendCrossSpectrum() const;
-  void sendPhaseSpectrum() const;
-  void sendBearing() const;
+  // One frame of the emulated device, run by scheduler_
+  void tick();
+  // Start or stop the frames or the replay according to the device mode
+  void applyMode(DeviceMode mode);
+  // Send a replayed message to the clients that show it
+  void sendRecord(const ICaptureRecord &record);
+  // True if some client has a long queue of unsent messages
+  bool clientsBusy();
+  // Recalculate the axes after a change of freqCenter_ or fftSize_
+  void updateAxes();
+  // Change the state sent on connection: modify(snapshotState_)
+  template <typename Modify> void updateSnapshot(Modify modify);
+  // Rebuild the connect snapshot on the next connection, without a lock
+  void invalidateSnapshot();
+  // Number of points in the transmitted arrays
+  size_t wireSize() const;
+  // Apply the device state and compute the signals of the next frame
+  void processFrame(const IDeviceState &state);
+  // Locked sendMtx_ while recording, an empty lock otherwise
+  std::unique_lock<std::mutex> captureLock();
+  // Send a JSON message to all clients of the device. A deviceLog message
+  // carries the sequence number of its last entry.
+  void broadcastText(const std::string &str, uint64_t logSeq = 0);
+
+  // Which variants of a channel the subscribed clients need this frame
+  IDemand getDemand(IChart IChartState::*chart) const;
+  void broadcast(const IFramePayload &payload, IChart IChartState::*chart);
+  // Send a frame message to the client, or hold it for the client's batch
+  void deliver(IClient &client, const IGatherMessage &message);
+  // Send the held messages of every batching client in one envelope
+  void flushBatches();
+  // Send a channel array of wireSize() points at start + i * step to the
+  // clients that show the chart of the message code. Each client gets its
+  // IChartView; every distinct variant is built once per frame by
+  // encode(view, demand) and taken from variants_ afterwards.
+  template <typename Encode>
+  void broadcastViews(uint8_t code, float start, float step, Encode encode);
+
+  void sendSamplesChan();
+  void sendSpectrumChan();
+  void sendCrossSpectrum();
+  void sendPhaseSpectrum();
+  void sendBearing();
   void sendDeviceLog();
 
 private:
+  size_t index_;
+  // Serializes the writers of deviceState_. The frames read the state
+  // without locking.
   std::mutex mtx_;
 
+  // Clients of this device. Connecting and disconnecting never wait for
+  // the frame, which iterates a snapshot.
+  ClientRegistry<websocket_session> clients_;
+  // Sessions of the current frame, kept alive until the frame is sent.
+  // Accessed by the frame only.
+  std::vector<IClient> frameClients_;
+  // Taken only while recording, around the capture append and the fan-out
+  // of one message, so the capture gets the messages in the order they are
+  // sent. See captureLock().
+  std::mutex sendMtx_;
+
   float freqCenter_;
   float sampleRate_;
   float dF_;
@@ -48,10 +159,51 @@ private:
   float timeMax_;
 
   size_t frame_;
+  // Gains of the last computed frame
+  uint8_t gainChan0_ = 0;
+  uint8_t gainChan1_ = 0;
+  // The cross spectrum was computed in the last frame
+  bool crossDemanded_ = false;
+  // Stopped by the shutdown of the device state
+  boost::asio::io_context *ioc_ = nullptr;
+  std::unique_ptr<FrameScheduler> scheduler_;
+  FrameScheduler::clock::time_point lastReport_;
+  // Set before start() and reset by stop(), constant while the device runs
+  std::unique_ptr<CaptureWriter> recorder_;
+  FrameVariantCache variants_; // Accessed by the frame only
+  std::shared_ptr<const CaptureReader> replayCapture_;
+  double replaySpeed_ = 1;
+  std::unique_ptr<CaptureReplay> replay_;
+  SignalEngine signal_;
+  CrossSpectrum cross_;
+  BearingEstimator bearing_;
 
-  IDeviceState deviceState_;
+  Seqlock<IDeviceState> deviceState_;
   IChartAxisLimits chartAxisLimits_;
-  std::vector<IDeviceLogMsg> deviceLog_;
+
+  // Written by the frame thread only; appends never wait for the readers.
+  // A session registers before it takes its snapshot, so every entry is
+  // either in the snapshot or broadcast to the session. The session drops
+  // the broadcast entries its snapshot already has, see connectClient().
+  LogRing deviceLog_;
+
+  // Parts of the connect snapshot written by the frames. The device state
+  // is read from deviceState_ and the log from deviceLog_ when the snapshot
+  // is built.
+  struct ISnapshotState {
+    IChartAxisLimits chartAxisLimits;
+  };
+  std::mutex snapshotMtx_;
+  ISnapshotState snapshotState_; // Accessed under snapshotMtx_
+  std::atomic<uint64_t> snapshotVersion_{0};
+  std::shared_ptr<const IConnectSnapshot> snapshot_; // Under snapshotMtx_
 };
 
-extern DevEmulator emulator;
\ No newline at end of file
+// Emulated devices, the count is set at startup
+extern std::vector<std::unique_ptr<DevEmulator>> devices;
+
+// Device selected by the WebSocket URL path: "/" is device 0, "/device/<n>"
+// is device n. Returns nullptr for an unknown path or device number.
+DevEmulator *findDevice(std::string_view target);
+// Parse the query string of the WebSocket URL, unknown parameters are ignored
+IConnectOptions parseConnectOptions(std::string_view target);
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "bearingEstimator.h"
+#include "../helpers/fastRandom.h"
+#include "kernels.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kSpeedOfLight = 299792458.0;
+constexpr double kArrayRadius = 0.1; // м
+
+double degToRad(double deg) { return deg * kPi / 180; }
+
+} // namespace
+
+void BearingEstimator::setFreqCenter(float freqCenter) {
+  if (steeringValid_ && freqCenter == freqCenter_)
+    return;
+  freqCenter_ = freqCenter;
+  buildSteering();
+  steeringValid_ = true;
+}
+
+void BearingEstimator::buildSteering() {
+  steerRe_.resize(kElements * kAzimuths);
+  steerIm_.resize(kElements * kAzimuths);
+
+  double k = 2 * kPi * freqCenter_ / kSpeedOfLight * kArrayRadius;
+  for (int n = 0; n < kElements; n++) {
+    double elementAngle = 2 * kPi * n / kElements;
+    for (size_t az = 0; az < kAzimuths; az++) {
+      double phase = k * std::cos(degToRad(az * kStep) - elementAngle);
+      steerRe_[n * kAzimuths + az] = static_cast<float>(std::cos(phase));
+      steerIm_[n * kAzimuths + az] = static_cast<float>(std::sin(phase));
+    }
+  }
+}
+
+void BearingEstimator::process(float sourceBearing, float snrDb) {
+  simulateSnapshot(sourceBearing, snrDb);
+  evaluatePattern();
+  estimate();
+}
+
+void BearingEstimator::simulateSnapshot(float sourceBearing, float snrDb) {
+  auto &rnd = FastRandom::local();
+  // Unit amplitude source with a random carrier phase, uniform noise with
+  // the requested SNR per element
+  float noiseAmp = std::sqrt(1.5f) * std::pow(10.0f, -snrDb / 20.0f);
+  float carrier = rnd.uniform(0, static_cast<float>(2 * kPi));
+
+  double k = 2 * kPi * freqCenter_ / kSpeedOfLight * kArrayRadius;
+  for (int n = 0; n < kElements; n++) {
+    double elementAngle = 2 * kPi * n / kElements;
+    double phase =
+        carrier + k * std::cos(degToRad(sourceBearing) - elementAngle);
+    snapRe_[n] =
+        static_cast<float>(std::cos(phase)) + rnd.uniform(-noiseAmp, noiseAmp);
+    snapIm_[n] =
+        static_cast<float>(std::sin(phase)) + rnd.uniform(-noiseAmp, noiseAmp);
+  }
+
+  // Element amplitudes in dB and phases relative to element 0
+  for (int n = 0; n < kElements; n++) {
+    float power = snapRe_[n] * snapRe_[n] + snapIm_[n] * snapIm_[n];
+    ampDb_[n] = saturateInt16(kDbPerLog2 * fastLog2(power + 1e-20f));
+    float re = snapRe_[n] * snapRe_[0] + snapIm_[n] * snapIm_[0];
+    float im = snapIm_[n] * snapRe_[0] - snapRe_[n] * snapIm_[0];
+    phaseDeg_[n] = saturateInt16(fastAtan2(im, re) * 57.2957795f);
+  }
+}
+
+void BearingEstimator::evaluatePattern() {
+  // a^H(az) * x for all azimuths, one element per pass over the table so the
+  // azimuth loop is contiguous and vectorized
+  std::fill(patternRe_, patternRe_ + kAzimuths, 0.0f);
+  std::fill(patternIm_, patternIm_ + kAzimuths, 0.0f);
+  float energy = 0;
+  for (int n = 0; n < kElements; n++) {
+    const float *aRe = steerRe_.data() + n * kAzimuths;
+    const float *aIm = steerIm_.data() + n * kAzimuths;
+    const float xRe = snapRe_[n], xIm = snapIm_[n];
+    for (size_t az = 0; az < kAzimuths; az++) {
+      patternRe_[az] += aRe[az] * xRe + aIm[az] * xIm;
+      patternIm_[az] += aRe[az] * xIm - aIm[az] * xRe;
+    }
+    energy += xRe * xRe + xIm * xIm;
+  }
+
+  // Normalized to a correlation coefficient in [0, 1]
+  float norm = 1.0f / (kElements * energy + 1e-20f);
+  for (size_t az = 0; az < kAzimuths; az++)
+    beamPattern_[az] = (patternRe_[az] * patternRe_[az] +
+                        patternIm_[az] * patternIm_[az]) *
+                       norm;
+}
+
+void BearingEstimator::estimate() {
+  auto peakIt = std::max_element(beamPattern_.begin(), beamPattern_.end());
+  size_t peak = peakIt - beamPattern_.begin();
+  float peakValue = *peakIt;
+
+  // Parabolic interpolation between the neighbouring azimuths
+  float left = beamPattern_[(peak + kAzimuths - 1) % kAzimuths];
+  float right = beamPattern_[(peak + 1) % kAzimuths];
+  float denom = left - 2 * peakValue + right;
+  float offset = denom < 0 ? 0.5f * (left - right) / denom : 0.0f;
+  bearing_ = std::fmod((peak + offset) * kStep + 360.0f, 360.0f);
+
+  quality_ = static_cast<uint8_t>(std::lround(peakValue * 100));
+
+  // Half power beam width around the peak
+  size_t halfWidth = 0;
+  while (halfWidth < kAzimuths / 2 &&
+         beamPattern_[(peak + halfWidth) % kAzimuths] > 0.5f * peakValue)
+    halfWidth++;
+
+  // Beam width over the square root of the array SNR, with the SNR derived
+  // from the peak correlation: rho = snr / (1 + snr)
+  float rho = std::min(peakValue, 0.9999f);
+  float snr = kElements * rho / (1 - rho);
+  bearingStd_ = 2 * halfWidth * kStep / std::sqrt(2 * snr);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Direction finder with a uniform circular array of kElements antennas.
+//
+// Emulates one snapshot of the element signals from a source at a given
+// bearing and estimates the bearing from the Bartlett beam pattern, which
+// is evaluated as a matrix-vector product of the steering table (all
+// azimuths x all elements) and the snapshot.
+class BearingEstimator {
+public:
+  static constexpr int kElements = 7;
+  static constexpr float kStep = 0.5f; // Шаг по азимуту, град
+  static constexpr size_t kAzimuths = 720;
+
+  // Steering vectors depend on the wavelength only, so the table is rebuilt
+  // when the centre frequency changes and reused otherwise
+  void setFreqCenter(float freqCenter);
+
+  void process(float sourceBearing, float snrDb);
+
+  float bearing() const { return bearing_; }
+  uint8_t quality() const { return quality_; }
+  float bearingStd() const { return bearingStd_; }
+  const std::vector<int16_t> &ampDistribution() const { return ampDb_; }
+  const std::vector<int16_t> &phaseDistribution() const { return phaseDeg_; }
+  const std::vector<float> &beamPattern() const { return beamPattern_; }
+
+private:
+  void buildSteering();
+  void simulateSnapshot(float sourceBearing, float snrDb);
+  void evaluatePattern();
+  void estimate();
+
+  float freqCenter_ = 0;
+  bool steeringValid_ = false;
+  // exp(i * phase) of element n at azimuth k in [n * kAzimuths + k]
+  std::vector<float> steerRe_;
+  std::vector<float> steerIm_;
+
+  float snapRe_[kElements];
+  float snapIm_[kElements];
+  float patternRe_[kAzimuths];
+  float patternIm_[kAzimuths];
+
+  float bearing_ = 0;
+  uint8_t quality_ = 0;
+  float bearingStd_ = 0;
+  std::vector<int16_t> ampDb_ = std::vector<int16_t>(kElements);
+  std::vector<int16_t> phaseDeg_ = std::vector<int16_t>(kElements);
+  std::vector<float> beamPattern_ = std::vector<float>(kAzimuths);
+};
@@ -0,0 +1,42 @@
+#include "crossSpectrum.h"
+#include "kernels.h"
+#include <algorithm>
+
+void CrossSpectrum::setAveraging(float alpha) {
+  alpha_ = std::min(std::max(alpha, 0.001f), 1.0f);
+}
+
+void CrossSpectrum::process(const IChannelFrame &chan0,
+                            const IChannelFrame &chan1, float refDb) {
+  const size_t n = chan0.fftRe.size();
+  if (re_.size() != n) {
+    re_.resize(n);
+    im_.resize(n);
+    avgRe_.resize(n);
+    avgIm_.resize(n);
+    spectrumDb_.resize(n);
+    phaseDeg_.resize(n);
+    reset();
+  }
+
+  conjMultiply(chan0.fftRe.data(), chan0.fftIm.data(), chan1.fftRe.data(),
+               chan1.fftIm.data(), n, re_.data(), im_.data());
+
+  const float *re = re_.data();
+  const float *im = im_.data();
+  if (alpha_ < 1.0f) {
+    if (hasHistory_) {
+      expAverage(re_.data(), n, alpha_, avgRe_.data());
+      expAverage(im_.data(), n, alpha_, avgIm_.data());
+    } else {
+      avgRe_ = re_;
+      avgIm_ = im_;
+      hasHistory_ = true;
+    }
+    re = avgRe_.data();
+    im = avgIm_.data();
+  }
+
+  magnitudeDb(re, im, n, refDb, spectrumDb_.data());
+  ::phaseDeg(re, im, n, phaseDeg_.data());
+}
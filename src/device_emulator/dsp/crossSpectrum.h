@@ -0,0 +1,34 @@
+#pragma once
+
+#include "signalEngine.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Cross spectrum of the two receiver channels, S = X0 * conj(X1), computed
+// from the channel spectra of the current frame. Optionally averaged over
+// frames: S_avg += alpha * (S - S_avg).
+class CrossSpectrum {
+public:
+  // 1 disables averaging. Keeps the current average, see reset().
+  void setAveraging(float alpha);
+  // Drop the average: the next frame starts a new one
+  void reset() { hasHistory_ = false; }
+
+  void process(const IChannelFrame &chan0, const IChannelFrame &chan1,
+               float refDb);
+
+  const std::vector<int8_t> &spectrumDb() const { return spectrumDb_; }
+  const std::vector<int16_t> &phaseDeg() const { return phaseDeg_; }
+
+private:
+  float alpha_ = 1.0f;
+  bool hasHistory_ = false;
+
+  std::vector<float> re_;
+  std::vector<float> im_;
+  std::vector<float> avgRe_;
+  std::vector<float> avgIm_;
+  std::vector<int8_t> spectrumDb_; // Взаимный спектр, дБ
+  std::vector<int16_t> phaseDeg_;  // Фаза, град
+};
@@ -0,0 +1,139 @@
+#include "fft.h"
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Radix-4 pass. Butterfly inputs are l*m apart, outputs m apart.
+void radix4(const float *xRe, const float *xIm, float *yRe, float *yIm,
+            size_t l, size_t m, const float *w1Re, const float *w1Im,
+            const float *w2Re, const float *w2Im, const float *w3Re,
+            const float *w3Im) {
+  const size_t q = l * m;
+  auto butterfly = [&](size_t j, size_t k) {
+    size_t in = k + m * j;
+    float aRe = xRe[in], aIm = xIm[in];
+    float bRe = xRe[in + q], bIm = xIm[in + q];
+    float cRe = xRe[in + 2 * q], cIm = xIm[in + 2 * q];
+    float dRe = xRe[in + 3 * q], dIm = xIm[in + 3 * q];
+
+    float t0Re = aRe + cRe, t0Im = aIm + cIm;
+    float t1Re = aRe - cRe, t1Im = aIm - cIm;
+    float t2Re = bRe + dRe, t2Im = bIm + dIm;
+    // -i * (b - d)
+    float t3Re = bIm - dIm, t3Im = dRe - bRe;
+
+    float u1Re = t1Re + t3Re, u1Im = t1Im + t3Im;
+    float u2Re = t0Re - t2Re, u2Im = t0Im - t2Im;
+    float u3Re = t1Re - t3Re, u3Im = t1Im - t3Im;
+
+    size_t out = k + 4 * m * j;
+    yRe[out] = t0Re + t2Re;
+    yIm[out] = t0Im + t2Im;
+    yRe[out + m] = u1Re * w1Re[j] - u1Im * w1Im[j];
+    yIm[out + m] = u1Re * w1Im[j] + u1Im * w1Re[j];
+    yRe[out + 2 * m] = u2Re * w2Re[j] - u2Im * w2Im[j];
+    yIm[out + 2 * m] = u2Re * w2Im[j] + u2Im * w2Re[j];
+    yRe[out + 3 * m] = u3Re * w3Re[j] - u3Im * w3Im[j];
+    yIm[out + 3 * m] = u3Re * w3Im[j] + u3Im * w3Re[j];
+  };
+
+  // Keep the longer loop innermost so it is the one that gets vectorized
+  if (m == 1) {
+    for (size_t j = 0; j < l; j++)
+      butterfly(j, 0);
+  } else {
+    for (size_t j = 0; j < l; j++)
+      for (size_t k = 0; k < m; k++)
+        butterfly(j, k);
+  }
+}
+
+// Radix-2 pass, used once as the last pass for odd powers of two
+void radix2(const float *xRe, const float *xIm, float *yRe, float *yIm,
+            size_t l, size_t m, const float *wRe, const float *wIm) {
+  const size_t q = l * m;
+  for (size_t j = 0; j < l; j++) {
+    for (size_t k = 0; k < m; k++) {
+      size_t in = k + m * j;
+      float aRe = xRe[in], aIm = xIm[in];
+      float bRe = xRe[in + q], bIm = xIm[in + q];
+      float dRe = aRe - bRe, dIm = aIm - bIm;
+
+      size_t out = k + 2 * m * j;
+      yRe[out] = aRe + bRe;
+      yIm[out] = aIm + bIm;
+      yRe[out + m] = dRe * wRe[j] - dIm * wIm[j];
+      yIm[out + m] = dRe * wIm[j] + dIm * wRe[j];
+    }
+  }
+}
+
+} // namespace
+
+Fft::Fft(size_t size) : size_{size} {
+  if (size < 2 || (size & (size - 1)) != 0)
+    throw std::invalid_argument("Fft: size must be a power of two");
+
+  size_t m = 1;
+  while (m < size) {
+    int radix = (size / m) % 4 == 0 ? 4 : 2;
+    size_t l = size / (radix * m);
+    IStage stage{l, m, radix, twRe_.size()};
+
+    // w = exp(-2*pi*i / (radix * l)), powers 1..radix-1 stored one after
+    // another, l values each
+    for (int p = 1; p < radix; p++) {
+      for (size_t j = 0; j < l; j++) {
+        double angle = -2.0 * kPi * static_cast<double>(p * j) /
+                       static_cast<double>(radix * l);
+        twRe_.push_back(static_cast<float>(std::cos(angle)));
+        twIm_.push_back(static_cast<float>(std::sin(angle)));
+      }
+    }
+    stages_.push_back(stage);
+    m *= radix;
+  }
+}
+
+const Fft &Fft::get(size_t size) {
+  static std::mutex mtx;
+  static std::map<size_t, std::unique_ptr<Fft>> plans;
+
+  std::lock_guard lock{mtx};
+  auto &plan = plans[size];
+  if (!plan)
+    plan = std::make_unique<Fft>(size);
+  return *plan;
+}
+
+void Fft::forward(float *re, float *im, float *work) const {
+  float *xRe = re, *xIm = im;
+  float *yRe = work, *yIm = work + size_;
+
+  for (auto &stage : stages_) {
+    const float *wRe = twRe_.data() + stage.twiddle;
+    const float *wIm = twIm_.data() + stage.twiddle;
+    if (stage.radix == 4) {
+      size_t l = stage.l;
+      radix4(xRe, xIm, yRe, yIm, l, stage.m, wRe, wIm, wRe + l, wIm + l,
+             wRe + 2 * l, wIm + 2 * l);
+    } else {
+      radix2(xRe, xIm, yRe, yIm, stage.l, stage.m, wRe, wIm);
+    }
+    std::swap(xRe, yRe);
+    std::swap(xIm, yIm);
+  }
+
+  // After an odd number of passes the result is in the work buffer
+  if (xRe != re) {
+    std::memcpy(re, xRe, size_ * sizeof(float));
+    std::memcpy(im, xIm, size_ * sizeof(float));
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Forward complex FFT of power-of-two size on split re/im arrays.
+//
+// Stockham auto-sort formulation: radix-4 passes with one radix-2 pass for
+// odd powers of two. The output is in natural order, so no bit reversal is
+// needed, and every pass runs over contiguous memory that the compiler
+// vectorizes. Twiddles are computed once per size.
+class Fft {
+public:
+  explicit Fft(size_t size);
+
+  // Shared immutable plan for the size, built on first request
+  static const Fft &get(size_t size);
+
+  size_t size() const { return size_; }
+
+  // Transform in place. `work` must hold 2 * size() floats.
+  void forward(float *re, float *im, float *work) const;
+
+private:
+  struct IStage {
+    size_t l; // Number of butterfly groups
+    size_t m; // Distance between the outputs of a butterfly
+    int radix;
+    size_t twiddle; // Offset of the stage twiddles
+  };
+
+  size_t size_;
+  std::vector<IStage> stages_;
+  // w^j, w^2j, w^3j of every radix-4 stage and w^j of the radix-2 one
+  std::vector<float> twRe_;
+  std::vector<float> twIm_;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Elementwise DSP kernels. Written as plain branch-free loops over split
+// re/im arrays so the compiler vectorizes them.
+
+// 10 * log10(2): converts log2 of a power to dB
+constexpr float kDbPerLog2 = 3.01029995664f;
+
+// log2(x) for normal x > 0, absolute error below 2e-5
+inline float fastLog2(float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  float exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+  bits = (bits & 0x007fffffu) | 0x3f800000u;
+  float mantissa; // [1, 2)
+  std::memcpy(&mantissa, &bits, sizeof(mantissa));
+
+  // log2(m) = 2 / ln(2) * atanh(t), t = (m - 1) / (m + 1) < 1/3
+  float t = (mantissa - 1.0f) / (mantissa + 1.0f);
+  float t2 = t * t;
+  float series =
+      t * (1.0f + t2 * (1.0f / 3 + t2 * (1.0f / 5 + t2 * (1.0f / 7))));
+  return exponent + 2.88539008178f * series;
+}
+
+// Round to nearest and saturate to the int8 range. Shifted to positive
+// values first, so truncation rounds and the loop stays branch-free.
+inline int8_t saturateInt8(float value) {
+  float shifted = std::min(std::max(value + 128.5f, 0.5f), 255.5f);
+  return static_cast<int8_t>(static_cast<int32_t>(shifted) - 128);
+}
+
+// Round to nearest and saturate to the int16 range
+inline int16_t saturateInt16(float value) {
+  float shifted = std::min(std::max(value + 32768.5f, 0.5f), 65535.5f);
+  return static_cast<int16_t>(static_cast<int32_t>(shifted) - 32768);
+}
+
+// out = 10 * log10(re^2 + im^2) - refDb, as int8 dB
+inline void powerDb(const float *re, const float *im, size_t size,
+                    float refDb, int8_t *out) {
+  for (size_t i = 0; i < size; i++) {
+    // The offset keeps log2 away from zero and denormals
+    float power = re[i] * re[i] + im[i] * im[i] + 1e-20f;
+    out[i] = saturateInt8(kDbPerLog2 * fastLog2(power) - refDb);
+  }
+}
+
+// data *= window
+inline void applyWindow(const float *window, size_t size, float *data) {
+  for (size_t i = 0; i < size; i++)
+    data[i] *= window[i];
+}
+
+// out = a * conj(b)
+inline void conjMultiply(const float *aRe, const float *aIm, const float *bRe,
+                         const float *bIm, size_t size, float *outRe,
+                         float *outIm) {
+  for (size_t i = 0; i < size; i++) {
+    outRe[i] = aRe[i] * bRe[i] + aIm[i] * bIm[i];
+    outIm[i] = aIm[i] * bRe[i] - aRe[i] * bIm[i];
+  }
+}
+
+// acc += alpha * (value - acc)
+inline void expAverage(const float *value, size_t size, float alpha,
+                       float *acc) {
+  for (size_t i = 0; i < size; i++)
+    acc[i] += alpha * (value[i] - acc[i]);
+}
+
+// out = 10 * log10(|re + i*im|) - refDb, as int8 dB. For a cross spectrum
+// the magnitude is already a product of two amplitudes, i.e. a power.
+inline void magnitudeDb(const float *re, const float *im, size_t size,
+                        float refDb, int8_t *out) {
+  for (size_t i = 0; i < size; i++) {
+    float power = re[i] * re[i] + im[i] * im[i] + 1e-20f;
+    out[i] = saturateInt8(0.5f * kDbPerLog2 * fastLog2(power) - refDb);
+  }
+}
+
+// 1 for negative values (including -0), 0 otherwise
+inline uint32_t signBit(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits >> 31;
+}
+
+// atan2(y, x) in radians, absolute error below 1e-5. The quadrant is fixed
+// up with sign bits instead of comparisons, which would keep the compiler
+// from vectorizing the loop under the default -ftrapping-math.
+inline float fastAtan2(float y, float x) {
+  constexpr float kPi = 3.14159265358979f;
+  float ax = std::abs(x), ay = std::abs(y);
+  float a = std::min(ax, ay) / (std::max(ax, ay) + 1e-30f);
+  float s = a * a;
+  // Minimax polynomial of atan on [0, 1]
+  float r =
+      a * (0.99997726f +
+           s * (-0.33262347f +
+                s * (0.19354346f +
+                     s * (-0.11643287f + s * (0.05265332f - s * 0.01172120f)))));
+  // |y| > |x|: pi/2 - r
+  r += static_cast<float>(signBit(ax - ay)) * (kPi / 2 - 2 * r);
+  // x < 0: pi - r
+  r += static_cast<float>(signBit(x)) * (kPi - 2 * r);
+  return std::copysign(r, y);
+}
+
+// out = arg(re + i*im), as int16 degrees
+inline void phaseDeg(const float *re, const float *im, size_t size,
+                     int16_t *out) {
+  constexpr float kDegPerRad = 57.2957795131f;
+  for (size_t i = 0; i < size; i++)
+    out[i] = saturateInt16(kDegPerRad * fastAtan2(im[i], re[i]));
+}
+
+// Minimum and maximum of every bucket, written to out as (min, max) pairs.
+// Bucket b covers [b * size / buckets, (b + 1) * size / buckets), so
+// buckets <= size is required. Integer min/max reductions vectorize.
+template <typename T>
+inline void minMaxBuckets(const T *in, size_t size, size_t buckets, T *out) {
+  for (size_t b = 0; b < buckets; b++) {
+    size_t begin = b * size / buckets;
+    size_t end = (b + 1) * size / buckets;
+    T lo = in[begin], hi = in[begin];
+    for (size_t i = begin + 1; i < end; i++) {
+      lo = std::min(lo, in[i]);
+      hi = std::max(hi, in[i]);
+    }
+    out[2 * b] = lo;
+    out[2 * b + 1] = hi;
+  }
+}
@@ -0,0 +1,154 @@
+#include "signalEngine.h"
+#include "../helpers/fastRandom.h"
+#include "fft.h"
+#include "kernels.h"
+#include <cmath>
+#include <utility>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Tones are generated kBlock samples at a time: a block of phasors is rotated
+// as a whole, which vectorizes, instead of calling sin/cos per sample.
+constexpr size_t kBlock = 16;
+
+float dbToAmplitude(float db) { return std::pow(10.0f, db / 20.0f); }
+
+// Storage for the samples of the next frame. The array of the previous frame
+// is reused unless a client still holds it.
+int16_t *writableSamples(std::shared_ptr<std::vector<int16_t>> &samples,
+                         size_t size) {
+  if (!samples || samples.use_count() > 1)
+    samples = std::make_shared<std::vector<int16_t>>(size);
+  else
+    samples->resize(size);
+  return samples->data();
+}
+
+} // namespace
+
+SignalEngine::SignalEngine(ISignalConfig config) { setConfig(config); }
+
+void SignalEngine::setConfig(ISignalConfig config) {
+  config_ = std::move(config);
+  tonePhase_.assign(config_.tones.size(), 0.0);
+}
+
+void SignalEngine::resize(size_t fftSize) {
+  fftSize_ = fftSize;
+
+  // Periodic Hann window
+  window_.resize(fftSize);
+  double windowSum = 0;
+  for (size_t i = 0; i < fftSize; i++) {
+    window_[i] = static_cast<float>(
+        0.5 - 0.5 * std::cos(2 * kPi * static_cast<double>(i) /
+                             static_cast<double>(fftSize)));
+    windowSum += window_[i];
+  }
+  refDb_ = static_cast<float>(20 * std::log10(kFullScale * windowSum));
+
+  workRe_.resize(fftSize);
+  workIm_.resize(fftSize);
+  fftWork_.resize(2 * fftSize);
+  for (auto &chan : channels_) {
+    chan.fftRe.resize(fftSize);
+    chan.fftIm.resize(fftSize);
+    chan.spectrumDb.resize(fftSize);
+  }
+}
+
+void SignalEngine::process(size_t fftSize, float sampleRate,
+                           const float gainDb[kChannels]) {
+  if (fftSize != fftSize_)
+    resize(fftSize);
+
+  for (int chan = 0; chan < kChannels; chan++) {
+    synthesize(chan, sampleRate, gainDb[chan]);
+    analyse(chan);
+  }
+
+  for (size_t t = 0; t < config_.tones.size(); t++) {
+    double step = 2 * kPi * config_.tones[t].freqOffset / sampleRate;
+    tonePhase_[t] =
+        std::fmod(tonePhase_[t] + step * static_cast<double>(fftSize),
+                  2 * kPi);
+  }
+}
+
+void SignalEngine::synthesize(int chan, float sampleRate, float gainDb) {
+  const size_t n = fftSize_;
+  float *re = workRe_.data();
+  float *im = workIm_.data();
+
+  // Uniform noise with the configured power, split between re and im
+  float noiseRms = kFullScale * dbToAmplitude(config_.noiseLevel);
+  float noiseAmp = noiseRms * std::sqrt(1.5f);
+  auto &rnd = FastRandom::local();
+  rnd.fill(re, n, -noiseAmp, noiseAmp);
+  rnd.fill(im, n, -noiseAmp, noiseAmp);
+
+  double chanPhase = chan == 1 ? config_.chan1Phase * kPi / 180 : 0.0;
+  for (size_t t = 0; t < config_.tones.size(); t++) {
+    const ITone &tone = config_.tones[t];
+    double amp = kFullScale * dbToAmplitude(tone.level);
+    double step = 2 * kPi * tone.freqOffset / sampleRate;
+    double phase = tonePhase_[t] + chanPhase;
+
+    float pRe[kBlock], pIm[kBlock];
+    for (size_t k = 0; k < kBlock; k++) {
+      pRe[k] = static_cast<float>(amp * std::cos(phase + step * k));
+      pIm[k] = static_cast<float>(amp * std::sin(phase + step * k));
+    }
+    float rotRe = static_cast<float>(std::cos(step * kBlock));
+    float rotIm = static_cast<float>(std::sin(step * kBlock));
+
+    for (size_t i = 0; i < n; i += kBlock) {
+      for (size_t k = 0; k < kBlock; k++) {
+        re[i + k] += pRe[k];
+        im[i + k] += pIm[k];
+        float nextRe = pRe[k] * rotRe - pIm[k] * rotIm;
+        pIm[k] = pRe[k] * rotIm + pIm[k] * rotRe;
+        pRe[k] = nextRe;
+      }
+    }
+  }
+
+  // Receiver gain and ADC quantization
+  float gain = dbToAmplitude(gainDb);
+  auto &frame = channels_[chan];
+  int16_t *outRe = writableSamples(frame.re, n);
+  int16_t *outIm = writableSamples(frame.im, n);
+  for (size_t i = 0; i < n; i++) {
+    outRe[i] = saturateInt16(re[i] * gain);
+    outIm[i] = saturateInt16(im[i] * gain);
+  }
+}
+
+void SignalEngine::analyse(int chan) {
+  const size_t n = fftSize_;
+  auto &frame = channels_[chan];
+  float *re = workRe_.data();
+  float *im = workIm_.data();
+
+  const int16_t *samplesRe = frame.re->data();
+  const int16_t *samplesIm = frame.im->data();
+  for (size_t i = 0; i < n; i++) {
+    re[i] = samplesRe[i];
+    im[i] = samplesIm[i];
+  }
+  applyWindow(window_.data(), n, re);
+  applyWindow(window_.data(), n, im);
+  Fft::get(n).forward(re, im, fftWork_.data());
+
+  // Swap the halves so the spectrum runs from fMin to fMax
+  const size_t half = n / 2;
+  std::copy(re + half, re + n, frame.fftRe.begin());
+  std::copy(re, re + half, frame.fftRe.begin() + half);
+  std::copy(im + half, im + n, frame.fftIm.begin());
+  std::copy(im, im + half, frame.fftIm.begin() + half);
+
+  powerDb(frame.fftRe.data(), frame.fftIm.data(), n, refDb_,
+          frame.spectrumDb.data());
+}
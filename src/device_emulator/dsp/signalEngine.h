@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Sine tone of the emulated signal
+struct ITone {
+  float freqOffset; // Гц, отстройка от центральной частоты
+  float level;      // дБ относительно полной шкалы АЦП
+};
+
+struct ISignalConfig {
+  std::vector<ITone> tones{{-5.0e6f, -20.0f}, {3.2e6f, -35.0f}};
+  float noiseLevel = -60.0f; // дБ относительно полной шкалы АЦП
+  float chan1Phase = 60.0f;  // град, сдвиг фазы тонов в канале 1
+  // Коэффициент экспоненциального усреднения взаимного спектра (1 - нет)
+  float crossAveraging = 1.0f;
+};
+
+// Samples and spectrum of one channel for the current frame
+struct IChannelFrame {
+  // The samples are sent to the clients without copying. A frame writes new
+  // arrays while a client still holds the previous ones.
+  std::shared_ptr<std::vector<int16_t>> re; // Re отсчёты
+  std::shared_ptr<std::vector<int16_t>> im; // Im отсчёты
+  // Complex spectrum of the windowed samples, zero frequency in the middle
+  std::vector<float> fftRe;
+  std::vector<float> fftIm;
+  std::vector<int8_t> spectrumDb; // Спектр, дБ относительно полной шкалы
+};
+
+// Synthesizes IQ samples of both receiver channels and computes their
+// spectra: noise plus tones, Hann window, FFT, power in dB.
+class SignalEngine {
+public:
+  static constexpr int kChannels = 2;
+  // Full scale of the int16 samples
+  static constexpr float kFullScale = 32767.0f;
+
+  explicit SignalEngine(ISignalConfig config = {});
+
+  void setConfig(ISignalConfig config);
+  const ISignalConfig &config() const { return config_; }
+
+  // Produce the next frame. Tones keep their phase between frames, as if the
+  // frames were consecutive blocks of one stream.
+  void process(size_t fftSize, float sampleRate,
+               const float gainDb[kChannels]);
+
+  size_t fftSize() const { return fftSize_; }
+  // Level of a full scale tone in the FFT output, dB
+  float refDb() const { return refDb_; }
+  const IChannelFrame &channel(int idx) const { return channels_[idx]; }
+
+private:
+  void resize(size_t fftSize);
+  void synthesize(int chan, float sampleRate, float gainDb);
+  void analyse(int chan);
+
+  ISignalConfig config_;
+  size_t fftSize_ = 0;
+
+  std::vector<float> window_;
+  float refDb_ = 0; // Level of a full scale tone after the window and FFT
+
+  std::vector<float> workRe_;
+  std::vector<float> workIm_;
+  std::vector<float> fftWork_;
+
+  std::vector<double> tonePhase_; // Running phase of every tone, rad
+  IChannelFrame channels_[kChannels];
+};
@@ -0,0 +1,109 @@
+#include "frameScheduler.h"
+#include <algorithm>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+
+namespace net = boost::asio;
+
+namespace {
+
+FrameScheduler::clock::duration periodOf(double rate) {
+  return std::chrono::duration_cast<FrameScheduler::clock::duration>(
+      std::chrono::duration<double>(1 / rate));
+}
+
+} // namespace
+
+FrameScheduler::FrameScheduler(net::io_context &ioc, Callback tick)
+    : strand_{net::make_strand(ioc)}, timer_{strand_}, tick_{std::move(tick)},
+      period_{periodOf(config_.rate)} {}
+
+void FrameScheduler::setConfig(const ISchedulerConfig &config) {
+  net::dispatch(strand_, [this, config] {
+    config_ = config;
+    // The new period applies from the next deadline
+    period_ = periodOf(config_.rate);
+  });
+}
+
+void FrameScheduler::start() {
+  net::post(strand_, [this] {
+    if (running_)
+      return;
+    running_ = true;
+    generation_ += 1;
+    // The first frame is produced right away
+    deadline_ = clock::now();
+    wait();
+  });
+}
+
+void FrameScheduler::stop() {
+  net::post(strand_, [this] {
+    if (!running_)
+      return;
+    running_ = false;
+    generation_ += 1;
+    timer_.cancel();
+  });
+}
+
+ISchedulerStats FrameScheduler::stats() const {
+  ISchedulerStats stats;
+  stats.frames = frames_.load(std::memory_order_relaxed);
+  stats.lateFrames = lateFrames_.load(std::memory_order_relaxed);
+  stats.skippedFrames = skippedFrames_.load(std::memory_order_relaxed);
+  if (stats.frames) {
+    stats.jitterMeanUs =
+        static_cast<double>(jitterSumNs_.load(std::memory_order_relaxed)) /
+        static_cast<double>(stats.frames) / 1e3;
+  }
+  stats.jitterMaxUs =
+      static_cast<double>(jitterMaxNs_.load(std::memory_order_relaxed)) / 1e3;
+  return stats;
+}
+
+void FrameScheduler::wait() {
+  timer_.expires_at(deadline_);
+  timer_.async_wait([this, generation = generation_](
+                        const boost::system::error_code &ec) {
+    if (!ec)
+      onTimer(generation);
+  });
+}
+
+void FrameScheduler::onTimer(uint64_t generation) {
+  // A handler of a stopped or restarted run
+  if (generation != generation_ || !running_)
+    return;
+
+  auto now = clock::now();
+  auto lateness = std::max(now - deadline_, clock::duration::zero());
+  auto latenessNs = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(lateness).count());
+  jitterSumNs_.fetch_add(latenessNs, std::memory_order_relaxed);
+  if (latenessNs > jitterMaxNs_.load(std::memory_order_relaxed))
+    jitterMaxNs_.store(latenessNs, std::memory_order_relaxed);
+  if (lateness >= period_)
+    lateFrames_.fetch_add(1, std::memory_order_relaxed);
+
+  tick_();
+  frames_.fetch_add(1, std::memory_order_relaxed);
+
+  // Stay on the grid of the start time instead of now + period
+  deadline_ += period_;
+  now = clock::now();
+  if (deadline_ < now) {
+    // Deadlines already passed, including the next one
+    auto missed = static_cast<uint64_t>((now - deadline_) / period_) + 1;
+    uint64_t dropped = missed;
+    if (config_.overrun == OverrunPolicy::catchUp) {
+      // Run the backlog back to back, but not more than one second of it
+      auto backlog = static_cast<uint64_t>(std::max(1.0, config_.rate));
+      dropped = missed > backlog ? missed - backlog : 0;
+    }
+    deadline_ += period_ * static_cast<clock::rep>(dropped);
+    skippedFrames_.fetch_add(dropped, std::memory_order_relaxed);
+  }
+  wait();
+}
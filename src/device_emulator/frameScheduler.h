@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+// What to do with the frames whose deadline has already passed
+enum class OverrunPolicy {
+  catchUp, // run the missed frames back to back, up to one second of backlog
+  skip     // drop the missed frames and wait for the next deadline
+};
+
+struct ISchedulerConfig {
+  double rate = 2;                                // Частота фреймов, Гц
+  OverrunPolicy overrun = OverrunPolicy::catchUp; // Обработка опозданий
+};
+
+struct ISchedulerStats {
+  uint64_t frames = 0;        // Выполнено фреймов
+  uint64_t lateFrames = 0;    // Запущено позже дедлайна более чем на период
+  uint64_t skippedFrames = 0; // Пропущено из-за перегрузки
+  double jitterMeanUs = 0;    // Среднее отклонение запуска от дедлайна, мкс
+  double jitterMaxUs = 0;     // Максимальное отклонение, мкс
+};
+
+// Periodic frame timer on the io_context.
+//
+// Deadlines advance from the start time by whole periods, so the rate does not
+// drift by the duration of the frames. The callback runs on the scheduler's
+// own strand, one frame at a time. start() and stop() may be called from any
+// thread.
+class FrameScheduler {
+public:
+  using clock = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+
+  FrameScheduler(boost::asio::io_context &ioc, Callback tick);
+
+  void setConfig(const ISchedulerConfig &config);
+  // Do nothing if already running
+  void start();
+  // Pending frames are not run after stop() returns to the strand
+  void stop();
+
+  ISchedulerStats stats() const;
+
+private:
+  void wait();
+  void onTimer(uint64_t generation);
+
+private:
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+  boost::asio::steady_timer timer_;
+  Callback tick_;
+
+  // Only accessed on strand_
+  ISchedulerConfig config_;
+  clock::duration period_;
+  clock::time_point deadline_;
+  bool running_ = false;
+  uint64_t generation_ = 0; // Invalidates handlers of the previous start()
+
+  std::atomic<uint64_t> frames_{0};
+  std::atomic<uint64_t> lateFrames_{0};
+  std::atomic<uint64_t> skippedFrames_{0};
+  std::atomic<uint64_t> jitterSumNs_{0};
+  std::atomic<uint64_t> jitterMaxNs_{0};
+};
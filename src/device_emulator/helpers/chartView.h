@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../dsp/kernels.h"
+#include "../interfaces/IJsonMsg.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Part of a channel array sent to one client: the points inside the chart's
+// axisInterval, reduced to chartWidth min/max buckets when there are more
+// than two points per pixel.
+struct IChartView {
+  size_t first = 0;   // Первая точка в интервале
+  size_t count = 0;   // Число точек в интервале
+  size_t buckets = 0; // Число интервалов прореживания, 0 - без прореживания
+  float start = 0;    // Координата первой передаваемой точки
+  float step = 0;     // Шаг между передаваемыми точками
+
+  // Number of points sent
+  size_t size() const { return buckets ? 2 * buckets : count; }
+  // The whole array as it is
+  bool whole(size_t arraySize) const {
+    return first == 0 && count == arraySize && buckets == 0;
+  }
+  bool operator==(const IChartView &other) const {
+    return first == other.first && count == other.count &&
+           buckets == other.buckets;
+  }
+};
+
+// View of an array of `size` points at start + i * step
+inline IChartView makeChartView(const IChart &chart, float start, float step,
+                                size_t size) {
+  IChartView view;
+  view.count = size;
+  view.start = start;
+  view.step = step;
+
+  // An empty or reversed interval means the whole axis
+  float lo = chart.axisInterval[0], hi = chart.axisInterval[1];
+  if (hi > lo && size > 0 && step > 0) {
+    auto pos = [&](float x) { return (x - start) / step; };
+    auto end = static_cast<float>(size);
+    auto first = std::clamp(std::ceil(pos(lo)), 0.0f, end);
+    auto last = std::clamp(std::floor(pos(hi)) + 1, first, end);
+    view.first = static_cast<size_t>(first);
+    view.count = static_cast<size_t>(last) - view.first;
+    if (view.count < size)
+      // The int16 arrays are sent in even lengths
+      view.count -= view.count % 2;
+    view.start = start + static_cast<float>(view.first) * step;
+  }
+
+  if (chart.chartWidth > 0 && view.count > 2 * size_t{chart.chartWidth}) {
+    view.buckets = chart.chartWidth;
+    view.step = step * static_cast<float>(view.count) /
+                static_cast<float>(view.size());
+  }
+  return view;
+}
+
+// Points of the view taken from the whole array
+template <typename T>
+void applyChartView(const IChartView &view, const T *data,
+                    std::vector<T> &out) {
+  out.resize(view.size());
+  if (view.buckets)
+    minMaxBuckets(data + view.first, view.count, view.buckets, out.data());
+  else
+    std::copy(data + view.first, data + view.first + view.count, out.begin());
+}
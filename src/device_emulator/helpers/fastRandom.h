@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Fast uniform generator for the emulated data.
+//
+// Runs kLanes independent xoshiro128+ streams laid out as structure of arrays,
+// so the bulk fill loops are vectorized by the compiler. One instance per
+// thread is available through local(); no locking and no reseeding on the
+// hot path.
+class FastRandom {
+public:
+  static constexpr size_t kLanes = 16;
+
+  explicit FastRandom(uint64_t seed) {
+    // Expand the seed with splitmix64, as recommended for xoshiro
+    auto splitmix = [&seed]() {
+      seed += 0x9e3779b97f4a7c15ull;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      // The all-zero state is invalid for xoshiro
+      return static_cast<uint32_t>(z ^ (z >> 31)) | 1u;
+    };
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      state_.s0[lane] = splitmix();
+      state_.s1[lane] = splitmix();
+      state_.s2[lane] = splitmix();
+      state_.s3[lane] = splitmix();
+    }
+  }
+
+  // Make generators created after this call deterministic. Each thread gets
+  // its own stream derived from the seed in order of first use.
+  static void setSeed(uint64_t seed) {
+    seed_.store(seed);
+    seeded_.store(true);
+  }
+
+  // Generator of the calling thread
+  static FastRandom &local() {
+    thread_local FastRandom rnd{nextThreadSeed()};
+    return rnd;
+  }
+
+  // Single value in [min, max)
+  float uniform(float min, float max) {
+    if (cursor_ == kLanes) {
+      step(state_, block_);
+      cursor_ = 0;
+    }
+    return min + block_[cursor_++] * (max - min);
+  }
+
+  // Fill caller-supplied storage with values in [min, max). Integer types are
+  // truncated toward zero, as getRandomData does.
+  template <typename T> void fill(T *data, size_t size, float min, float max) {
+    const float scale = max - min;
+    // Work on a local copy of the state so the lanes stay in vector registers
+    State state = state_;
+    float block[kLanes];
+    size_t i = 0;
+    for (; i + kLanes <= size; i += kLanes) {
+      step(state, block);
+      for (size_t lane = 0; lane < kLanes; lane++)
+        data[i + lane] = static_cast<T>(min + block[lane] * scale);
+    }
+    if (i < size) {
+      step(state, block);
+      for (size_t lane = 0; i < size; lane++, i++)
+        data[i] = static_cast<T>(min + block[lane] * scale);
+    }
+    state_ = state;
+  }
+
+  template <typename T>
+  void fill(std::vector<T> &data, float min, float max) {
+    fill(data.data(), data.size(), min, max);
+  }
+
+private:
+  struct State {
+    uint32_t s0[kLanes], s1[kLanes], s2[kLanes], s3[kLanes];
+  };
+
+  // One step of every lane, converted to floats in [0, 1)
+  static void step(State &st, float *out) {
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      uint32_t result = st.s0[lane] + st.s3[lane];
+      uint32_t t = st.s1[lane] << 9;
+      st.s2[lane] ^= st.s0[lane];
+      st.s3[lane] ^= st.s1[lane];
+      st.s1[lane] ^= st.s2[lane];
+      st.s0[lane] ^= st.s3[lane];
+      st.s2[lane] ^= t;
+      st.s3[lane] = (st.s3[lane] << 11) | (st.s3[lane] >> 21);
+      // Top 24 bits are exactly representable in a float
+      out[lane] = static_cast<float>(result >> 8) * (1.0f / 16777216.0f);
+    }
+  }
+
+  static uint64_t nextThreadSeed() {
+    if (!seeded_.load()) {
+      std::random_device rnd_device;
+      return (uint64_t{rnd_device()} << 32) | rnd_device();
+    }
+    return seed_.load() + threadCounter_.fetch_add(1) * 0xd1b54a32d192ed03ull;
+  }
+
+  State state_;
+  float block_[kLanes];
+  size_t cursor_ = kLanes;
+
+  static inline std::atomic<bool> seeded_{false};
+  static inline std::atomic<uint64_t> seed_{0};
+  static inline std::atomic<uint64_t> threadCounter_{0};
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "../interfaces/IBinaryMsg.h"
+#include <boost/asio/buffer.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Immutable serialized message shared by all sessions it is sent to
+using IBuffer = std::shared_ptr<const std::vector<char>>;
+
+// Message written with one gather write. `owner` keeps the memory of the
+// buffers alive until every session has written it.
+struct IGatherMessage {
+  std::shared_ptr<const void> owner;
+  std::vector<boost::asio::const_buffer> buffers;
+
+  explicit operator bool() const { return owner != nullptr; }
+  size_t size() const { return boost::asio::buffer_size(buffers); }
+};
+
+// The first `size` bytes of a serialized message as one buffer
+inline IGatherMessage makeGatherMessage(const IBuffer &data, size_t size) {
+  return {data, {boost::asio::buffer(data->data(), size)}};
+}
+
+// Which encoded variants of a channel message the clients asked for
+struct IDemand {
+  bool plain = false;    // subscribers without metadata
+  bool metadata = false; // subscribers with metadata
+  bool any() const { return plain || metadata; }
+};
+
+// Encoded variants of one channel message for the current frame
+struct IFramePayload {
+  IGatherMessage plain;
+  IGatherMessage withMetadata;
+};
+
+// Serialize the message once per requested variant. The same buffers are
+// then handed to every subscribed client.
+template <typename TMsg>
+IFramePayload makeFramePayload(TMsg &msg, const IDemand &demand,
+                               const std::string &metadata) {
+  IFramePayload payload;
+  auto encode = [&msg]() {
+    auto buff = std::make_shared<const std::vector<char>>(msg.serialize());
+    return makeGatherMessage(buff, buff->size());
+  };
+  if (demand.plain) {
+    msg.metadata.clear();
+    msg.sizeMetadata = 0;
+    payload.plain = encode();
+  }
+  if (demand.metadata) {
+    msg.metadata = metadata;
+    msg.sizeMetadata = msg.metadata.size();
+    payload.withMetadata = encode();
+  }
+  return payload;
+}
+
+// Samples message sent straight from the shared channel samples: only the
+// header and the metadata tail are encoded, and the first msg.sizeArray
+// samples of `re` and `im` are written from where the frame produced them.
+inline IFramePayload
+makeSamplesPayload(ISamplesChan &msg,
+                   const std::shared_ptr<const std::vector<int16_t>> &re,
+                   const std::shared_ptr<const std::vector<int16_t>> &im,
+                   const IDemand &demand, const std::string &metadata) {
+  struct IOwner {
+    std::vector<char> encoded; // Header followed by the tail
+    std::shared_ptr<const std::vector<int16_t>> re;
+    std::shared_ptr<const std::vector<int16_t>> im;
+  };
+
+  auto encode = [&]() {
+    auto owner = std::make_shared<IOwner>();
+    size_t headSize = ISamplesChanHeader::encodedSize(msg);
+    owner->encoded.resize(headSize + ISamplesChanTail::encodedSize(msg));
+    char *encoded = owner->encoded.data();
+    ISamplesChanHeader::serializeInto(msg, encoded, headSize);
+    ISamplesChanTail::serializeInto(msg, encoded + headSize,
+                                    owner->encoded.size() - headSize);
+    owner->re = re;
+    owner->im = im;
+
+    size_t arrayBytes = sizeof(int16_t) * msg.sizeArray;
+    IGatherMessage message;
+    message.buffers = {
+        boost::asio::buffer(encoded, headSize),
+        boost::asio::buffer(owner->re->data(), arrayBytes),
+        boost::asio::buffer(owner->im->data(), arrayBytes),
+        boost::asio::buffer(encoded + headSize,
+                            owner->encoded.size() - headSize)};
+    message.owner = std::move(owner);
+    return message;
+  };
+
+  // The arrays are not part of the encoded message
+  msg.re.clear();
+  msg.im.clear();
+  IFramePayload payload;
+  if (demand.plain) {
+    msg.metadata.clear();
+    msg.sizeMetadata = 0;
+    payload.plain = encode();
+  }
+  if (demand.metadata) {
+    msg.metadata = metadata;
+    msg.sizeMetadata = msg.metadata.size();
+    payload.withMetadata = encode();
+  }
+  return payload;
+}
+
+// Offsets of the messages in a batch envelope are multiples of this
+constexpr size_t kBatchAlign = 4;
+
+// Batch envelope of up to 255 messages. Only the header and the table of
+// contents are encoded; the messages are written from their own buffers.
+inline IGatherMessage
+makeBatchMessage(const std::vector<IGatherMessage> &messages) {
+  struct IOwner {
+    std::vector<char> encoded; // Header followed by the table of contents
+    std::vector<std::shared_ptr<const void>> messages;
+  };
+  static constexpr char kPadding[kBatchAlign] = {};
+
+  IBatchHeader header{7, static_cast<uint8_t>(messages.size()), 0};
+  size_t headSize = IBatchHeaderLayout::encodedSize(header) +
+                    messages.size() * IBatchEntryLayout::encodedSize({});
+
+  auto owner = std::make_shared<IOwner>();
+  owner->encoded.resize(headSize);
+  char *out = owner->encoded.data();
+  char *end = out + headSize;
+  out += IBatchHeaderLayout::serializeInto(header, out, headSize);
+
+  IGatherMessage batch;
+  batch.buffers.push_back(boost::asio::buffer(owner->encoded));
+  size_t offset = headSize;
+  for (auto &message : messages) {
+    size_t size = message.size();
+    IBatchEntry entry{static_cast<uint32_t>(offset),
+                      static_cast<uint32_t>(size)};
+    out += IBatchEntryLayout::serializeInto(entry, out,
+                                            static_cast<size_t>(end - out));
+
+    batch.buffers.insert(batch.buffers.end(), message.buffers.begin(),
+                         message.buffers.end());
+    size_t padding = (kBatchAlign - size % kBatchAlign) % kBatchAlign;
+    if (padding)
+      batch.buffers.push_back(boost::asio::buffer(kPadding, padding));
+    offset += size + padding;
+    owner->messages.push_back(message.owner);
+  }
+  batch.owner = std::move(owner);
+  return batch;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../interfaces/IJsonMsg.h"
+#include "seqlock.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Bounded history of the device log.
+//
+// Entries get consecutive sequence numbers starting from 1, so a client can
+// ask for the entries after the last one it has seen. The slots are
+// allocated once: append() copies the texts into the oldest slots and neither
+// blocks nor allocates, so the frame thread logs without waiting for the
+// readers. Readers on other threads copy a slot through its seqlock and skip
+// the entries overwritten in the meantime. append() must be called from one
+// thread at a time.
+class LogRing {
+public:
+  // Longer messages are truncated to this many bytes
+  static constexpr size_t kTextMax = 232;
+
+  explicit LogRing(size_t capacity)
+      : capacity_{std::max<size_t>(capacity, 1)},
+        slots_{std::make_unique<Seqlock<ISlot>[]>(capacity_)} {}
+
+  LogRing(const LogRing &) = delete;
+  LogRing &operator=(const LogRing &) = delete;
+
+  size_t capacity() const { return capacity_; }
+  // Sequence number of the newest entry, 0 if the log is empty
+  // seq_cst, as the publication in append(): a session that registers and
+  // then reads lastSeq(), and a frame that appends and then takes the
+  // registry snapshot, cannot both miss the other's change
+  uint64_t lastSeq() const { return last_.load(std::memory_order_seq_cst); }
+
+  // Append the entries and set their sequence numbers. They are published
+  // together: lastSeq() never falls inside the batch.
+  void append(std::vector<IDeviceLogMsg> &entries) {
+    uint64_t seq = last_.load(std::memory_order_relaxed);
+    for (auto &entry : entries) {
+      entry.seq = ++seq;
+      store(seq, entry.type, entry.date, entry.message);
+    }
+    last_.store(seq, std::memory_order_seq_cst);
+  }
+
+  // Entries with a sequence number above `after`, oldest first. The ones
+  // already overwritten are missing.
+  std::vector<IDeviceLogMsg> since(uint64_t after) const {
+    return since(after, lastSeq());
+  }
+
+  // Entries after `after` up to `last`, a value lastSeq() has returned
+  std::vector<IDeviceLogMsg> since(uint64_t after, uint64_t last) const {
+    uint64_t first = last > capacity_ ? last - capacity_ + 1 : 1;
+    first = std::max(first, after + 1);
+
+    std::vector<IDeviceLogMsg> entries;
+    entries.reserve(first <= last ? last - first + 1 : 0);
+    for (uint64_t seq = first; seq <= last; seq++) {
+      auto slot = slots_[(seq - 1) % capacity_].load();
+      if (slot.seq != seq)
+        continue;
+      IDeviceLogMsg msg;
+      msg.type = slot.type;
+      msg.date = slot.date;
+      msg.message.assign(slot.text, slot.size);
+      msg.seq = seq;
+      entries.push_back(std::move(msg));
+    }
+    return entries;
+  }
+
+private:
+  struct ISlot {
+    uint64_t seq;        // Номер записи, 0 - пустой слот
+    uint64_t date;       // Время timeEPOX, мс
+    LogMsgType type;     // Тип сообщения
+    uint16_t size;       // Длина текста, байт
+    char text[kTextMax]; // Текст в кодировке 'utf-8'
+  };
+
+  // Copy the entry into its slot, not yet published
+  void store(uint64_t seq, LogMsgType type, uint64_t date,
+             std::string_view text) {
+    // Cut at a character boundary of the UTF-8 text
+    size_t size = std::min(text.size(), kTextMax);
+    while (size < text.size() && size > 0 &&
+           (static_cast<unsigned char>(text[size]) & 0xC0) == 0x80)
+      size--;
+
+    ISlot slot{};
+    slot.seq = seq;
+    slot.date = date;
+    slot.type = type;
+    slot.size = static_cast<uint16_t>(size);
+    std::memcpy(slot.text, text.data(), size);
+    slots_[(seq - 1) % capacity_].store(slot);
+  }
+
+  size_t capacity_;
+  std::unique_ptr<Seqlock<ISlot>[]> slots_;
+  std::atomic<uint64_t> last_{0};
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Sequence lock for a small trivially copyable value.
+//
+// load() never blocks the writer and never takes a lock: it copies the value
+// and retries if a store() ran in the meantime. The value is kept in relaxed
+// atomic words, so the concurrent copy is not a data race. Stores must be
+// serialized by the caller.
+template <typename T> class Seqlock {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "Seqlock: the value must be trivially copyable");
+
+public:
+  Seqlock() : Seqlock(T{}) {}
+  explicit Seqlock(const T &value) { store(value); }
+
+  Seqlock(const Seqlock &) = delete;
+  Seqlock &operator=(const Seqlock &) = delete;
+
+  void store(const T &value) {
+    uint64_t words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+
+    auto seq = seq_.load(std::memory_order_relaxed);
+    // Odd sequence: the readers retry
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; i++)
+      data_[i].store(words[i], std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  T load() const {
+    uint64_t words[kWords];
+    uint64_t seq;
+    do {
+      seq = seq_.load(std::memory_order_acquire);
+      for (size_t i = 0; i < kWords; i++)
+        words[i] = data_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != seq_.load(std::memory_order_relaxed));
+
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+private:
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint64_t> seq_{0};
+  std::atomic<uint64_t> data_[kWords];
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "chartView.h"
+#include "framePayload.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+// One encoded form of a channel message. The view stands for the chart's
+// axisInterval and chartWidth: charts that resolve to the same points share
+// the variant. The key has no encoding field: every message code goes on the
+// wire in exactly one encoding, so the code names it. A code sent in a second
+// encoding must add the encoding to the key, its equality and its hash.
+struct IVariantKey {
+  uint8_t code = 0;      // Код сообщения
+  bool metadata = false; // С метаданными
+  IChartView view;       // Передаваемые точки
+
+  bool operator==(const IVariantKey &other) const {
+    return code == other.code && metadata == other.metadata &&
+           view == other.view;
+  }
+};
+
+// Fails to compile when a field is added to the key, so that its equality
+// and hash are revisited along with it
+constexpr bool variantKeyFieldsCovered() {
+  auto [code, metadata, view] = IVariantKey{};
+  return code == 0 && !metadata && view.count == 0;
+}
+static_assert(variantKeyFieldsCovered(),
+              "IVariantKey changed: update operator== and IVariantKeyHash");
+
+struct IVariantKeyHash {
+  size_t operator()(const IVariantKey &key) const {
+    size_t h = std::hash<size_t>{}(key.view.first);
+    auto mix = [&h](size_t v) {
+      h ^= std::hash<size_t>{}(v) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    };
+    mix(key.view.count);
+    mix(key.view.buckets);
+    mix((size_t{key.code} << 8) | size_t{key.metadata});
+    return h;
+  }
+};
+
+struct IVariantCacheStats {
+  uint64_t hits = 0;   // Вариант взят из кэша
+  uint64_t misses = 0; // Вариант закодирован
+};
+
+// Encoded variants of the current frame, shared by all sessions that ask for
+// the same one. The encoding cost of a frame grows with the number of
+// distinct variants rather than with the number of clients.
+// Not thread-safe: the caller serializes the frame.
+class FrameVariantCache {
+public:
+  // Variant for the key; build() encodes it on the first request of the frame
+  template <typename Build>
+  const IGatherMessage &get(const IVariantKey &key, Build &&build) {
+    auto it = variants_.find(key);
+    if (it != variants_.end()) {
+      stats_.hits++;
+      return it->second;
+    }
+    stats_.misses++;
+    return variants_.emplace(key, build()).first->second;
+  }
+
+  // Release the variants at the end of the frame
+  void clear() { variants_.clear(); }
+
+  IVariantCacheStats stats() const { return stats_; }
+
+private:
+  std::unordered_map<IVariantKey, IGatherMessage, IVariantKeyHash> variants_;
+  IVariantCacheStats stats_;
+};
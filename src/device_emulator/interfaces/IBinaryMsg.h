@@ -1,14 +1,13 @@
 #pragma once
 
+#include "binaryLayout.h"
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
 
-void serializeField(std::vector<char> &buff, const char *ptr, size_t size) {
-  for (size_t i = 0; i < size; i++) {
-    buff.push_back(ptr[i]);
-  }
-}
+// Largest sizeArray of the int16 arrays: uint16 on the wire, and even
+constexpr size_t kMaxSizeArray = UINT16_MAX & ~size_t{1};
 
 #pragma pack(push, 1)
 struct ISamplesChan {
@@ -24,23 +23,31 @@ struct ISamplesChan {
   uint16_t sizeMetadata; // uint16, Размер строки с метаданными
   std::string metadata; // string, Строка с метаданными в кодировке 'utf-8'
 
-  std::vector<char> serialize() {
-    std::vector<char> buff;
-    serializeField(buff, (const char *)&code, sizeof(code));
-    serializeField(buff, (const char *)&timeStart, sizeof(timeStart));
-    serializeField(buff, (const char *)&timeStep, sizeof(timeStep));
-    serializeField(buff, (const char *)&sizeArray, sizeof(sizeArray));
-    serializeField(buff, (const char *)&emptyByte, sizeof(emptyByte));
-    serializeField(buff, (const char *)&re[0], sizeof(int16_t) * re.size());
-    serializeField(buff, (const char *)&im[0], sizeof(int16_t) * im.size());
-    serializeField(buff, (const char *)&sizeMetadata, sizeof(sizeMetadata));
-    serializeField(buff, (const char *)&metadata[0],
-                   sizeof(char) * metadata.size());
-    return buff;
-  }
+  std::vector<char> serialize() const;
 };
 #pragma pack(pop)
 
+// Wire format of ISamplesChan. The header and the tail are also used on
+// their own, to send the samples without copying them into the message.
+using ISamplesChanHeader =
+    BinaryLayout<ISamplesChan, Field<&ISamplesChan::code>,
+                 Field<&ISamplesChan::timeStart>,
+                 Field<&ISamplesChan::timeStep>,
+                 Field<&ISamplesChan::sizeArray>,
+                 Field<&ISamplesChan::emptyByte>>;
+using ISamplesChanTail =
+    BinaryLayout<ISamplesChan, Field<&ISamplesChan::sizeMetadata>,
+                 Array<&ISamplesChan::metadata, &ISamplesChan::sizeMetadata>>;
+using ISamplesChanLayout =
+    BinaryLayout<ISamplesChan, ISamplesChanHeader,
+                 Array<&ISamplesChan::re, &ISamplesChan::sizeArray>,
+                 Array<&ISamplesChan::im, &ISamplesChan::sizeArray>,
+                 ISamplesChanTail>;
+
+inline std::vector<char> ISamplesChan::serialize() const {
+  return ISamplesChanLayout::serialize(*this);
+}
+
 #pragma pack(push, 1)
 struct ISpectrumChan {
   uint8_t code; // uint8 [2 | 3], Код посылки
@@ -51,22 +58,23 @@ struct ISpectrumChan {
   uint16_t sizeMetadata; // uint16, Размер строки с метаданными
   std::string metadata; // string, Строка с метаданными в кодировке 'utf-8'
 
-  std::vector<char> serialize() {
-    std::vector<char> buff;
-    serializeField(buff, (const char *)&code, sizeof(code));
-    serializeField(buff, (const char *)&fStart, sizeof(fStart));
-    serializeField(buff, (const char *)&fStep, sizeof(fStep));
-    serializeField(buff, (const char *)&sizeArray, sizeof(sizeArray));
-    serializeField(buff, (const char *)&spectrum[0],
-                   sizeof(int8_t) * spectrum.size());
-    serializeField(buff, (const char *)&sizeMetadata, sizeof(sizeMetadata));
-    serializeField(buff, (const char *)&metadata[0],
-                   sizeof(char) * metadata.size());
-    return buff;
-  }
+  std::vector<char> serialize() const;
 };
 #pragma pack(pop)
 
+// Wire format of ISpectrumChan
+using ISpectrumChanLayout = BinaryLayout<
+    ISpectrumChan,
+    Field<&ISpectrumChan::code>, Field<&ISpectrumChan::fStart>,
+    Field<&ISpectrumChan::fStep>, Field<&ISpectrumChan::sizeArray>,
+    Array<&ISpectrumChan::spectrum, &ISpectrumChan::sizeArray>,
+    Field<&ISpectrumChan::sizeMetadata>,
+    Array<&ISpectrumChan::metadata, &ISpectrumChan::sizeMetadata>>;
+
+inline std::vector<char> ISpectrumChan::serialize() const {
+  return ISpectrumChanLayout::serialize(*this);
+}
+
 #pragma pack(push, 1)
 struct ICrossSpectrum {
   uint8_t code;  // uint8 [4], Код посылки
@@ -78,23 +86,24 @@ struct ICrossSpectrum {
   uint16_t sizeMetadata; // uint16, Размер строки с метаданными
   std::string metadata; // string, Строка с метаданными в кодировке 'utf-8'
 
-  std::vector<char> serialize() {
-    std::vector<char> buff;
-    serializeField(buff, (const char *)&code, sizeof(code));
-    serializeField(buff, (const char *)&date, sizeof(date));
-    serializeField(buff, (const char *)&fStart, sizeof(fStart));
-    serializeField(buff, (const char *)&fStep, sizeof(fStep));
-    serializeField(buff, (const char *)&sizeArray, sizeof(sizeArray));
-    serializeField(buff, (const char *)&spectrum[0],
-                   sizeof(int8_t) * spectrum.size());
-    serializeField(buff, (const char *)&sizeMetadata, sizeof(sizeMetadata));
-    serializeField(buff, (const char *)&metadata[0],
-                   sizeof(char) * metadata.size());
-    return buff;
-  }
+  std::vector<char> serialize() const;
 };
 #pragma pack(pop)
 
+// Wire format of ICrossSpectrum
+using ICrossSpectrumLayout = BinaryLayout<
+    ICrossSpectrum,
+    Field<&ICrossSpectrum::code>, Field<&ICrossSpectrum::date>,
+    Field<&ICrossSpectrum::fStart>, Field<&ICrossSpectrum::fStep>,
+    Field<&ICrossSpectrum::sizeArray>,
+    Array<&ICrossSpectrum::spectrum, &ICrossSpectrum::sizeArray>,
+    Field<&ICrossSpectrum::sizeMetadata>,
+    Array<&ICrossSpectrum::metadata, &ICrossSpectrum::sizeMetadata>>;
+
+inline std::vector<char> ICrossSpectrum::serialize() const {
+  return ICrossSpectrumLayout::serialize(*this);
+}
+
 #pragma pack(push, 1)
 struct IPhaseSpectrum {
   uint8_t code; // uint8 [5], Код посылки
@@ -106,23 +115,24 @@ struct IPhaseSpectrum {
   uint16_t sizeMetadata; // uint16, Размер строки с метаданными
   std::string metadata; // string, Строка с метаданными в кодировке 'utf-8'
 
-  std::vector<char> serialize() {
-    std::vector<char> buff;
-    serializeField(buff, (const char *)&code, sizeof(code));
-    serializeField(buff, (const char *)&fStart, sizeof(fStart));
-    serializeField(buff, (const char *)&fStep, sizeof(fStep));
-    serializeField(buff, (const char *)&sizeArray, sizeof(sizeArray));
-    serializeField(buff, (const char *)&emptyByte, sizeof(emptyByte));
-    serializeField(buff, (const char *)&phase[0],
-                   sizeof(int16_t) * phase.size());
-    serializeField(buff, (const char *)&sizeMetadata, sizeof(sizeMetadata));
-    serializeField(buff, (const char *)&metadata[0],
-                   sizeof(char) * metadata.size());
-    return buff;
-  }
+  std::vector<char> serialize() const;
 };
 #pragma pack(pop)
 
+// Wire format of IPhaseSpectrum
+using IPhaseSpectrumLayout = BinaryLayout<
+    IPhaseSpectrum,
+    Field<&IPhaseSpectrum::code>, Field<&IPhaseSpectrum::fStart>,
+    Field<&IPhaseSpectrum::fStep>, Field<&IPhaseSpectrum::sizeArray>,
+    Field<&IPhaseSpectrum::emptyByte>,
+    Array<&IPhaseSpectrum::phase, &IPhaseSpectrum::sizeArray>,
+    Field<&IPhaseSpectrum::sizeMetadata>,
+    Array<&IPhaseSpectrum::metadata, &IPhaseSpectrum::sizeMetadata>>;
+
+inline std::vector<char> IPhaseSpectrum::serialize() const {
+  return IPhaseSpectrumLayout::serialize(*this);
+}
+
 #pragma pack(push, 1)
 struct IBearing {
   uint8_t code;           // uint8 [6], Код посылки
@@ -141,29 +151,45 @@ struct IBearing {
   uint16_t sizeMetadata; // uint16, Размер строки с метаданными
   std::string metadata; // string, Строка с метаданными в кодировке 'utf-8'
 
-  std::vector<char> serialize() {
-    std::vector<char> buff;
-    serializeField(buff, (const char *)&code, sizeof(code));
-    serializeField(buff, (const char *)&bearing, sizeof(bearing));
-    serializeField(buff, (const char *)&bearingQuality, sizeof(bearingQuality));
-    serializeField(buff, (const char *)&bearingStd, sizeof(bearingStd));
-    serializeField(buff, (const char *)&sizeArrayDistribution,
-                   sizeof(sizeArrayDistribution));
-    serializeField(buff, (const char *)&ampDistribution[0],
-                   sizeof(int16_t) * ampDistribution.size());
-    serializeField(buff, (const char *)&phaseDistribution[0],
-                   sizeof(int16_t) * phaseDistribution.size());
-    serializeField(buff, (const char *)&beamPatternStep,
-                   sizeof(beamPatternStep));
-    serializeField(buff, (const char *)&sizeArrayBeamPattern,
-                   sizeof(sizeArrayBeamPattern));
-    serializeField(buff, (const char *)&emptyBytes[0], sizeof(uint8_t) * 2);
-    serializeField(buff, (const char *)&beamPattern[0],
-                   sizeof(float) * beamPattern.size());
-    serializeField(buff, (const char *)&sizeMetadata, sizeof(sizeMetadata));
-    serializeField(buff, (const char *)&metadata[0],
-                   sizeof(char) * metadata.size());
-    return buff;
-  }
+  std::vector<char> serialize() const;
+};
+#pragma pack(pop)
+// Wire format of IBearing
+using IBearingLayout = BinaryLayout<
+    IBearing,
+    Field<&IBearing::code>, Field<&IBearing::bearing>,
+    Field<&IBearing::bearingQuality>, Field<&IBearing::bearingStd>,
+    Field<&IBearing::sizeArrayDistribution>,
+    Array<&IBearing::ampDistribution, &IBearing::sizeArrayDistribution>,
+    Array<&IBearing::phaseDistribution, &IBearing::sizeArrayDistribution>,
+    Field<&IBearing::beamPatternStep>, Field<&IBearing::sizeArrayBeamPattern>,
+    Field<&IBearing::emptyBytes>,
+    Array<&IBearing::beamPattern, &IBearing::sizeArrayBeamPattern>,
+    Field<&IBearing::sizeMetadata>,
+    Array<&IBearing::metadata, &IBearing::sizeMetadata>>;
+
+inline std::vector<char> IBearing::serialize() const {
+  return IBearingLayout::serialize(*this);
+}
+
+#pragma pack(push, 1)
+// Envelope with the binary messages of one frame, for the clients that ask
+// for batching. The table of contents follows the header; each message
+// starts at an offset that is a multiple of 4.
+struct IBatchHeader {
+  uint8_t code;        // uint8 [7], Код посылки
+  uint8_t count;       // uint8, Число сообщений в посылке
+  uint16_t emptyBytes; // uint16, Нужен для выравнивания до кратности 4ки
 };
-#pragma pack(pop)
\ No newline at end of file
+struct IBatchEntry {
+  uint32_t offset; // uint32, Смещение сообщения от начала посылки, байт
+  uint32_t size;   // uint32, Размер сообщения без выравнивания, байт
+};
+#pragma pack(pop)
+// Wire format of the batch envelope, written by makeBatchMessage
+using IBatchHeaderLayout =
+    BinaryLayout<IBatchHeader, Field<&IBatchHeader::code>,
+                 Field<&IBatchHeader::count>, Field<&IBatchHeader::emptyBytes>>;
+using IBatchEntryLayout =
+    BinaryLayout<IBatchEntry, Field<&IBatchEntry::offset>,
+                 Field<&IBatchEntry::size>>;
@@ -55,7 +55,10 @@ void to_json(json &j, const LogMsgType &s) {
 // ================= IDeviceLogMsg ==============
 // GUI only read
 void to_json(json &j, const IDeviceLogMsg &s) {
-  j = json{{"type", s.type}, {"date", s.date}, {"message", s.message}};
+  j = json{{"type", s.type},
+           {"date", s.date},
+           {"message", s.message},
+           {"seq", s.seq}};
 };
 // void from_json(const json &j, IDeviceLogMsg &s) {};
 
@@ -103,4 +106,6 @@ void from_json(const json &j, IChartState &s) {
     j.at("phaseSpectrum").get_to(s.phaseSpectrum);
   if (j.contains("bearing"))
     j.at("bearing").get_to(s.bearing);
+  if (j.contains("batch"))
+    j.at("batch").get_to(s.batch);
 };
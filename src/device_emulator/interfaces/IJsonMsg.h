@@ -34,6 +34,7 @@ struct IDeviceLogMsg {
   LogMsgType type;
   uint64_t date;
   std::string message;
+  uint64_t seq = 0; // Номер записи в журнале устройства, начиная с 1
 };
 void to_json(json &j, const IDeviceLogMsg &s);
 // void from_json(const json &j, IDeviceLogMsg &s);
@@ -71,6 +72,7 @@ struct IChartState {
   IChart crossSpectrum;
   IChart phaseSpectrum;
   IChart bearing;
+  bool batch = false; // Сообщения фрейма одной посылкой (код 7)
 };
 // void to_json(json &j, const IChartState &s);
 void from_json(const json &j, IChartState &s);
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Compile-time description of a binary message: the fields in wire order.
+//
+//   using Layout = BinaryLayout<IMsg, Field<&IMsg::code>,
+//                               Array<&IMsg::data, &IMsg::sizeData>>;
+//
+// Field is a trivially copyable member (a number or a fixed array) and is
+// copied as is. Array is a std::vector or std::string member: its elements
+// follow one another, and on reading their count comes from an earlier
+// Field. A BinaryLayout of the same message may be used as a field, so a
+// message can also be encoded in parts. From the list the layout computes
+// the exact encoded size and serializes with one memcpy per field into a
+// buffer allocated once.
+
+template <auto Member> struct Field {};
+template <auto Member, auto Count> struct Array {};
+template <typename T, typename... Fields> struct BinaryLayout;
+
+namespace binaryLayoutDetail {
+
+template <typename T> struct MemberOf;
+template <typename C, typename M> struct MemberOf<M C::*> {
+  using Class = C;
+  using Type = M;
+};
+
+template <typename F> struct FieldCodec;
+
+template <auto Member> struct FieldCodec<Field<Member>> {
+  using Class = typename MemberOf<decltype(Member)>::Class;
+  using Type = typename MemberOf<decltype(Member)>::Type;
+  static_assert(std::is_trivially_copyable_v<Type>,
+                "Field: the member must be trivially copyable");
+
+  static size_t size(const Class &) { return sizeof(Type); }
+
+  // The members of the packed messages may be unaligned, so they are only
+  // accessed through char pointers
+  static char *write(const Class &msg, char *out) {
+    std::memcpy(out, reinterpret_cast<const char *>(&(msg.*Member)),
+                sizeof(Type));
+    return out + sizeof(Type);
+  }
+
+  static const char *read(Class &msg, const char *in, const char *end) {
+    if (static_cast<size_t>(end - in) < sizeof(Type))
+      return nullptr;
+    std::memcpy(reinterpret_cast<char *>(&(msg.*Member)), in, sizeof(Type));
+    return in + sizeof(Type);
+  }
+};
+
+template <auto Member, auto Count> struct FieldCodec<Array<Member, Count>> {
+  using Class = typename MemberOf<decltype(Member)>::Class;
+  using Element = typename MemberOf<decltype(Member)>::Type::value_type;
+  using CountType = typename MemberOf<decltype(Count)>::Type;
+  static_assert(std::is_trivially_copyable_v<Element>,
+                "Array: the elements must be trivially copyable");
+
+  static size_t size(const Class &msg) {
+    return sizeof(Element) * (msg.*Member).size();
+  }
+
+  static char *write(const Class &msg, char *out) {
+    size_t bytes = size(msg);
+    if (bytes)
+      std::memcpy(out, (msg.*Member).data(), bytes);
+    return out + bytes;
+  }
+
+  static const char *read(Class &msg, const char *in, const char *end) {
+    CountType count;
+    std::memcpy(&count, reinterpret_cast<const char *>(&(msg.*Count)),
+                sizeof(count));
+    size_t bytes = sizeof(Element) * static_cast<size_t>(count);
+    if (static_cast<size_t>(end - in) < bytes)
+      return nullptr;
+    (msg.*Member).resize(static_cast<size_t>(count));
+    if (bytes)
+      std::memcpy(reinterpret_cast<char *>((msg.*Member).data()), in, bytes);
+    return in + bytes;
+  }
+};
+
+template <typename T, typename... Fields>
+struct FieldCodec<BinaryLayout<T, Fields...>> : BinaryLayout<T, Fields...> {};
+
+} // namespace binaryLayoutDetail
+
+template <typename T, typename... Fields> struct BinaryLayout {
+  // Exact number of bytes written by serializeInto
+  static size_t encodedSize(const T &msg) { return size(msg); }
+
+  // Write the message into `out`, which must hold encodedSize(msg) bytes.
+  // Returns the number of bytes written, or 0 if `size` is too small.
+  static size_t serializeInto(const T &msg, char *out, size_t size) {
+    size_t bytes = encodedSize(msg);
+    if (size < bytes)
+      return 0;
+    write(msg, out);
+    return bytes;
+  }
+
+  static std::vector<char> serialize(const T &msg) {
+    std::vector<char> buff(encodedSize(msg));
+    serializeInto(msg, buff.data(), buff.size());
+    return buff;
+  }
+
+  // Read the message written by serializeInto. Returns false if the data is
+  // truncated; trailing bytes are not an error.
+  static bool deserialize(T &msg, const char *data, size_t size) {
+    return read(msg, data, data + size) != nullptr;
+  }
+
+  // Field interface, for nesting in another layout
+  static size_t size(const T &msg) {
+    return (binaryLayoutDetail::FieldCodec<Fields>::size(msg) + ...);
+  }
+
+  static char *write(const T &msg, char *out) {
+    ((out = binaryLayoutDetail::FieldCodec<Fields>::write(msg, out)), ...);
+    return out;
+  }
+
+  static const char *read(T &msg, const char *in, const char *end) {
+    ((in = in ? binaryLayoutDetail::FieldCodec<Fields>::read(msg, in, end)
+              : nullptr),
+     ...);
+    return in;
+  }
+};
@@ -0,0 +1,371 @@
+#include "controlMsg.h"
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+void IDeviceStateUpdate::applyTo(IDeviceState &target) const {
+  if (fields & kFieldMode)
+    target.mode = state.mode;
+  if (fields & kFieldShutdown)
+    target.shutdown = state.shutdown;
+  if (fields & kFieldFreqCenter)
+    target.freqCenter = state.freqCenter;
+  if (fields & kFieldSampleRateIdx)
+    target.sampleRateIdx = state.sampleRateIdx;
+  if (fields & kFieldFftSizeIdx)
+    target.fftSizeIdx = state.fftSizeIdx;
+  if (fields & kFieldGainChan0)
+    target.gainChan0 = state.gainChan0;
+  if (fields & kFieldGainChan1)
+    target.gainChan1 = state.gainChan1;
+}
+
+namespace {
+
+// Scalar value reported by the SAX parser
+struct IScalar {
+  enum class Kind { null, boolean, number, string };
+  explicit IScalar(Kind kind) : kind{kind} {}
+
+  Kind kind;
+  bool boolean = false;
+  double number = 0;
+  std::string_view text;
+};
+
+// A whole number that T holds, so the conversion is defined
+template <typename T> bool fitsInteger(const IScalar &value) {
+  return value.kind == IScalar::Kind::number &&
+         std::trunc(value.number) == value.number && value.number >= 0 &&
+         value.number <= std::numeric_limits<T>::max();
+}
+
+// A number within the range of float
+bool fitsFloat(const IScalar &value) {
+  return value.kind == IScalar::Kind::number &&
+         std::abs(value.number) <= std::numeric_limits<float>::max();
+}
+
+// Writes the fields of a control message as the parser reports them. The
+// position in the message is a stack of the open objects and arrays.
+class ControlHandler : public nlohmann::json_sax<json> {
+public:
+  ControlHandler(IControlMsg &msg, IChartState &chartState)
+      : msg_{msg}, chartState_{chartState} {}
+
+  const std::string &error() const { return error_; }
+
+  bool null() override { return scalar(IScalar{IScalar::Kind::null}); }
+  bool boolean(bool val) override {
+    IScalar value{IScalar::Kind::boolean};
+    value.boolean = val;
+    return scalar(value);
+  }
+  bool number_integer(number_integer_t val) override {
+    return number(static_cast<double>(val));
+  }
+  bool number_unsigned(number_unsigned_t val) override {
+    return number(static_cast<double>(val));
+  }
+  bool number_float(number_float_t val, const string_t &) override {
+    return number(val);
+  }
+  bool string(string_t &val) override {
+    IScalar value{IScalar::Kind::string};
+    value.text = val;
+    return scalar(value);
+  }
+  bool binary(binary_t &) override { return fail("unexpected binary value"); }
+
+  bool key(string_t &val) override {
+    key_ = val;
+    return true;
+  }
+
+  bool start_object(std::size_t) override {
+    if (scopes_.empty())
+      return push(Scope::root);
+    switch (scopes_.back().scope) {
+    case Scope::root:
+      if (key_ == "deviceState") {
+        msg_.hasDeviceState = true;
+        return push(Scope::deviceState);
+      }
+      if (key_ == "chartState") {
+        msg_.hasChartState = true;
+        return push(Scope::chartState);
+      }
+      return push(Scope::skipped);
+    case Scope::chartState:
+      chart_ = chartByName(key_);
+      if (chart_)
+        return push(Scope::chart);
+      return known() ? fail(expected()) : push(Scope::skipped);
+    case Scope::skipped:
+      return push(Scope::skipped);
+    default:
+      return known() ? fail(expected()) : push(Scope::skipped);
+    }
+  }
+  bool end_object() override { return pop(); }
+
+  bool start_array(std::size_t) override {
+    if (scopes_.empty())
+      return fail("object expected");
+    auto scope = scopes_.back().scope;
+    if (scope == Scope::chart && key_ == "axisInterval") {
+      axisIndex_ = 0;
+      return push(Scope::axisInterval);
+    }
+    if (scope == Scope::skipped || !known())
+      return push(Scope::skipped);
+    return fail(expected());
+  }
+  bool end_array() override {
+    if (scopes_.back().scope == Scope::axisInterval && axisIndex_ != 2)
+      return fail("two numbers expected");
+    return pop();
+  }
+
+  bool parse_error(std::size_t, const std::string &,
+                   const nlohmann::detail::exception &ex) override {
+    error_ = ex.what();
+    return false;
+  }
+
+private:
+  enum class Scope {
+    root,
+    deviceState,
+    chartState,
+    chart,
+    axisInterval,
+    skipped // unknown key, the value is ignored
+  };
+  struct IScope {
+    Scope scope;
+    std::string key; // Key of the object or array in its parent
+  };
+
+  static IChart IChartState::*chartMember(std::string_view name) {
+    if (name == "samplesChan0")
+      return &IChartState::samplesChan0;
+    if (name == "samplesChan1")
+      return &IChartState::samplesChan1;
+    if (name == "spectrumChan0")
+      return &IChartState::spectrumChan0;
+    if (name == "spectrumChan1")
+      return &IChartState::spectrumChan1;
+    if (name == "crossSpectrum")
+      return &IChartState::crossSpectrum;
+    if (name == "phaseSpectrum")
+      return &IChartState::phaseSpectrum;
+    if (name == "bearing")
+      return &IChartState::bearing;
+    return nullptr;
+  }
+
+  IChart *chartByName(std::string_view name) {
+    auto member = chartMember(name);
+    return member ? &(chartState_.*member) : nullptr;
+  }
+
+  static uint32_t deviceField(std::string_view name) {
+    if (name == "mode")
+      return kFieldMode;
+    if (name == "shutdown")
+      return kFieldShutdown;
+    if (name == "freqCenter")
+      return kFieldFreqCenter;
+    if (name == "sampleRateIdx")
+      return kFieldSampleRateIdx;
+    if (name == "fftSizeIdx")
+      return kFieldFftSizeIdx;
+    if (name == "gainChan0")
+      return kFieldGainChan0;
+    if (name == "gainChan1")
+      return kFieldGainChan1;
+    return 0;
+  }
+
+  // Whether the current key is one of the fields of the current object
+  bool known() const {
+    switch (scopes_.back().scope) {
+    case Scope::root:
+      return key_ == "deviceState" || key_ == "chartState";
+    case Scope::deviceState:
+      return deviceField(key_) != 0;
+    case Scope::chartState:
+      return key_ == "batch" || chartMember(key_);
+    case Scope::chart:
+      return key_ == "show" || key_ == "chartWidth" ||
+             key_ == "axisInterval" || key_ == "metadata";
+    case Scope::axisInterval:
+      return true;
+    case Scope::skipped:
+      return false;
+    }
+    return false;
+  }
+
+  // Expected type of the current field
+  const char *expected() const {
+    switch (scopes_.back().scope) {
+    case Scope::root:
+      return "object expected";
+    case Scope::deviceState:
+      if (key_ == "mode")
+        return "\"on\" or \"off\" expected";
+      if (key_ == "shutdown")
+        return "boolean expected";
+      return key_ == "freqCenter" ? "number expected"
+                                  : "integer 0..255 expected";
+    case Scope::chartState:
+      return key_ == "batch" ? "boolean expected" : "object expected";
+    case Scope::chart:
+      if (key_ == "axisInterval")
+        return "two numbers expected";
+      return key_ == "chartWidth" ? "integer 0..65535 expected"
+                                  : "boolean expected";
+    default:
+      return "number expected";
+    }
+  }
+
+  bool number(double val) {
+    IScalar value{IScalar::Kind::number};
+    value.number = val;
+    return scalar(value);
+  }
+
+  bool scalar(const IScalar &value) {
+    if (scopes_.empty())
+      return fail("object expected");
+    switch (scopes_.back().scope) {
+    case Scope::deviceState:
+      return setDeviceField(value);
+    case Scope::chartState:
+      if (key_ == "batch" && value.kind == IScalar::Kind::boolean) {
+        chartState_.batch = value.boolean;
+        return true;
+      }
+      return known() ? fail(expected()) : true;
+    case Scope::chart:
+      return setChartField(value);
+    case Scope::axisInterval:
+      if (!fitsFloat(value) || axisIndex_ >= 2)
+        return fail("two numbers expected");
+      chart_->axisInterval[axisIndex_++] = static_cast<float>(value.number);
+      return true;
+    case Scope::root:
+      return known() ? fail(expected()) : true;
+    case Scope::skipped:
+      return true;
+    }
+    return true;
+  }
+
+  bool setDeviceField(const IScalar &value) {
+    auto field = deviceField(key_);
+    auto &state = msg_.deviceState.state;
+    bool ok = true;
+    switch (field) {
+    case 0:
+      return true;
+    case kFieldMode:
+      ok = value.kind == IScalar::Kind::string &&
+           (value.text == "on" || value.text == "off");
+      state.mode = value.text == "on" ? DeviceMode::on : DeviceMode::off;
+      break;
+    case kFieldShutdown:
+      ok = value.kind == IScalar::Kind::boolean;
+      state.shutdown = value.boolean;
+      break;
+    case kFieldFreqCenter:
+      ok = fitsFloat(value);
+      if (ok)
+        state.freqCenter = static_cast<float>(value.number);
+      break;
+    default:
+      ok = fitsInteger<uint8_t>(value);
+      if (!ok)
+        break;
+      if (field == kFieldSampleRateIdx)
+        state.sampleRateIdx = static_cast<uint8_t>(value.number);
+      else if (field == kFieldFftSizeIdx)
+        state.fftSizeIdx = static_cast<uint8_t>(value.number);
+      else if (field == kFieldGainChan0)
+        state.gainChan0 = static_cast<uint8_t>(value.number);
+      else
+        state.gainChan1 = static_cast<uint8_t>(value.number);
+    }
+    if (!ok)
+      return fail(expected());
+    msg_.deviceState.fields |= field;
+    return true;
+  }
+
+  bool setChartField(const IScalar &value) {
+    if (key_ == "chartWidth" && fitsInteger<uint16_t>(value)) {
+      chart_->chartWidth = static_cast<uint16_t>(value.number);
+      return true;
+    }
+    if (value.kind == IScalar::Kind::boolean) {
+      if (key_ == "show") {
+        chart_->show = value.boolean;
+        return true;
+      }
+      if (key_ == "metadata") {
+        chart_->metadata = value.boolean;
+        return true;
+      }
+    }
+    return known() ? fail(expected()) : true;
+  }
+
+  bool push(Scope scope) {
+    scopes_.push_back({scope, scopes_.empty() ? std::string{} : key_});
+    return true;
+  }
+  bool pop() {
+    scopes_.pop_back();
+    return true;
+  }
+
+  // Describe the error with the path of the field: "chartState.bearing.show"
+  bool fail(const char *what) {
+    std::string path;
+    for (auto &scope : scopes_) {
+      if (!scope.key.empty())
+        path += scope.key + '.';
+    }
+    // The elements of axisInterval have no key of their own
+    if (!scopes_.empty() && scopes_.back().scope != Scope::axisInterval)
+      path += key_;
+    if (!path.empty() && path.back() == '.')
+      path.pop_back();
+    error_ = path.empty() ? what : path + ": " + what;
+    return false;
+  }
+
+  IControlMsg &msg_;
+  IChartState &chartState_;
+  std::vector<IScope> scopes_;
+  std::string key_;
+  IChart *chart_ = nullptr; // Chart of Scope::chart and Scope::axisInterval
+  size_t axisIndex_ = 0;
+  std::string error_;
+};
+
+} // namespace
+
+bool parseControlMsg(const char *data, size_t size, IControlMsg &msg,
+                     IChartState &chartState, std::string &error) {
+  ControlHandler handler{msg, chartState};
+  if (!json::sax_parse(data, data + size, &handler)) {
+    error = handler.error();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "IJsonMsg.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Fields of IDeviceState present in a control message
+enum DeviceStateField : uint32_t {
+  kFieldMode = 1u << 0,
+  kFieldShutdown = 1u << 1,
+  kFieldFreqCenter = 1u << 2,
+  kFieldSampleRateIdx = 1u << 3,
+  kFieldFftSizeIdx = 1u << 4,
+  kFieldGainChan0 = 1u << 5,
+  kFieldGainChan1 = 1u << 6,
+};
+
+// Partial update of the device state: only the fields flagged in `fields`
+// were sent by the client
+struct IDeviceStateUpdate {
+  IDeviceState state{}; // Полученные значения
+  uint32_t fields = 0;  // Маска DeviceStateField
+
+  // Copy the received fields over the current state
+  void applyTo(IDeviceState &target) const;
+};
+
+// Request of a client: {"deviceState": {...}, "chartState": {...}}
+struct IControlMsg {
+  bool hasDeviceState = false;
+  IDeviceStateUpdate deviceState;
+  bool hasChartState = false;
+};
+
+// Parse a control message straight from the received bytes with the
+// nlohmann SAX interface: no copy of the message and no JSON DOM. The chart
+// state update is merged into `chartState`, which holds the current state of
+// the session. Unknown keys are skipped. Returns false and describes the
+// problem in `error` if the JSON is malformed or a field has the wrong type;
+// nothing is thrown, and the partly merged `chartState` must be discarded.
+bool parseControlMsg(const char *data, size_t size, IControlMsg &msg,
+                     IChartState &chartState, std::string &error);
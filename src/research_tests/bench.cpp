@@ -0,0 +1,55 @@
+// Microbenchmarks of the emulator hot paths.
+// The build defaults to Release; a Debug build gives meaningless numbers.
+//
+// Usage: emulator_bench [name...]
+// Without arguments runs every benchmark.
+
+#include "compress_bench.hpp"
+#include "control_bench.hpp"
+#include "decode_bench.hpp"
+#include "dsp_bench.hpp"
+#include "log_bench.hpp"
+#include "random_bench.hpp"
+#include "registry_bench.hpp"
+#include "send_bench.hpp"
+#include "serialize_bench.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  const std::vector<std::pair<const char *, std::function<void()>>> benches{
+      {"random", random_bench},
+      {"dsp", dsp_bench},
+      {"serialize", serialize_bench},
+      {"compress", compress_bench},
+      {"decode", decode_bench},
+      {"control", control_bench},
+      {"log", log_bench},
+      {"registry", registry_bench},
+      {"send", send_bench},
+  };
+
+  bool found = argc < 2;
+  for (auto &[name, bench] : benches) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; i++)
+      selected = selected || std::strcmp(argv[i], name) == 0;
+    if (selected) {
+      found = true;
+      bench();
+    }
+  }
+
+  if (!found) {
+    std::cerr << "Usage: emulator_bench [name...]\nBenchmarks:";
+    for (auto &[name, bench] : benches)
+      std::cerr << ' ' << name;
+    std::cerr << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
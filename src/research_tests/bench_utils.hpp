@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+inline const void *volatile benchSink = nullptr;
+
+// Keep the optimizer from dropping a computed value
+template <typename T> inline void doNotOptimize(const T &value) {
+  benchSink = &value;
+}
+
+// Average time of one call of fn, ns. Repeats the call until at least
+// minTime has passed so short operations are measured reliably.
+template <typename Fn>
+double measureNs(Fn &&fn, std::chrono::milliseconds minTime =
+                              std::chrono::milliseconds(200)) {
+  using clock = std::chrono::steady_clock;
+  fn(); // warm up caches and lazily built tables
+
+  size_t iterations = 0;
+  auto start = clock::now();
+  auto elapsed = clock::duration::zero();
+  do {
+    fn();
+    iterations++;
+    elapsed = clock::now() - start;
+  } while (elapsed < minTime);
+
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         static_cast<double>(iterations);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "../device_emulator/dsp/crossSpectrum.h"
+#include "../device_emulator/dsp/signalEngine.h"
+#include "../device_emulator/interfaces/IBinaryMsg.h"
+#include "../device_emulator/interfaces/IJsonMsg.h"
+#include "bench_utils.hpp"
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Size of a message compressed as permessage-deflate sends it with Beast's
+// defaults: level 8, memLevel 4, 32 KB window. The stream is reset for every
+// message, as without context takeover.
+inline size_t deflatedSize(boost::beast::zlib::deflate_stream &ds,
+                           const std::vector<char> &data,
+                           std::vector<char> &out) {
+  namespace zlib = boost::beast::zlib;
+  ds.reset(8, 15, 4, zlib::Strategy::normal);
+  out.resize(ds.upper_bound(data.size()) + 16);
+  zlib::z_params zs;
+  zs.next_in = data.data();
+  zs.avail_in = data.size();
+  zs.next_out = out.data();
+  zs.avail_out = out.size();
+  boost::beast::error_code ec;
+  ds.write(zs, zlib::Flush::sync, ec);
+  // The empty block that ends a sync flush is not sent
+  return zs.total_out - 4;
+}
+
+// Compression ratio and CPU time per frame of every message kind, to tell
+// whether --deflate=all pays off on a link
+void compress_bench() {
+  std::cout << "compress_bench\n";
+  const float sampleRate = 30.72e6f;
+  const float gainDb[SignalEngine::kChannels] = {12, 15};
+
+  for (size_t fftSize = 128; fftSize <= 65536; fftSize *= 8) {
+    SignalEngine engine;
+    CrossSpectrum cross;
+    engine.process(fftSize, sampleRate, gainDb);
+    cross.process(engine.channel(0), engine.channel(1), engine.refDb());
+    auto sizeArray = static_cast<uint16_t>(std::min<size_t>(fftSize, 65535));
+
+    ISamplesChan samples{};
+    samples.sizeArray = sizeArray;
+    samples.re.assign(engine.channel(0).re->begin(),
+                      engine.channel(0).re->begin() + sizeArray);
+    samples.im.assign(engine.channel(0).im->begin(),
+                      engine.channel(0).im->begin() + sizeArray);
+
+    ISpectrumChan spectrum{};
+    spectrum.code = 2;
+    spectrum.sizeArray = sizeArray;
+    spectrum.spectrum.assign(engine.channel(0).spectrumDb.begin(),
+                             engine.channel(0).spectrumDb.begin() + sizeArray);
+
+    ICrossSpectrum crossSpectrum{};
+    crossSpectrum.code = 4;
+    crossSpectrum.sizeArray = sizeArray;
+    crossSpectrum.spectrum.assign(cross.spectrumDb().begin(),
+                                  cross.spectrumDb().begin() + sizeArray);
+
+    IPhaseSpectrum phase{};
+    phase.code = 5;
+    phase.sizeArray = sizeArray;
+    phase.phase.assign(cross.phaseDeg().begin(),
+                       cross.phaseDeg().begin() + sizeArray);
+
+    // Device log broadcast every 50 frames, counted per frame
+    std::vector<IDeviceLogMsg> log(10, {LogMsgType::info, 1700000000000,
+                                        "Emulated device started"});
+    auto logText = json{{"deviceLog", log}}.dump();
+
+    struct IKind {
+      const char *name;
+      std::vector<char> data;
+      double perFrame;
+    };
+    std::vector<IKind> kinds{
+        {"samples", samples.serialize(), 2},
+        {"spectra", spectrum.serialize(), 2},
+        {"cross", crossSpectrum.serialize(), 1},
+        {"phase", phase.serialize(), 1},
+        {"json", {logText.begin(), logText.end()}, 1.0 / 50},
+    };
+
+    std::cout << "  fftSize " << fftSize << ":\n";
+    boost::beast::zlib::deflate_stream ds;
+    std::vector<char> out;
+    for (auto &kind : kinds) {
+      size_t size = deflatedSize(ds, kind.data, out);
+      double ns = measureNs([&] {
+        auto compressed = deflatedSize(ds, kind.data, out);
+        doNotOptimize(compressed);
+      });
+      auto raw = static_cast<double>(kind.data.size());
+      std::cout << "    " << std::left << std::setw(8) << kind.name
+                << std::right << std::setw(7) << kind.data.size() << " -> "
+                << std::setw(7) << size << " bytes, ratio " << std::fixed
+                << std::setprecision(2) << std::setw(5)
+                << raw / static_cast<double>(size) << ", " << std::setw(9)
+                << std::setprecision(1) << ns * kind.perFrame / 1000
+                << " us/frame, " << std::setw(6) << raw / ns * 1000
+                << " MB/s\n";
+    }
+  }
+}
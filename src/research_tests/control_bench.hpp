@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../device_emulator/interfaces/controlMsg.h"
+#include "bench_utils.hpp"
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Parsing of a chart state request: the former DOM parse followed by
+// from_json, and the SAX handler writing straight into the state
+void control_bench() {
+  std::cout << "control_bench\n";
+  const std::string request =
+      R"({"chartState":{"samplesChan0":{"show":true,"chartWidth":1200,)"
+      R"("axisInterval":[0,0.0001],"metadata":true},)"
+      R"("spectrumChan0":{"show":true,"chartWidth":1200,)"
+      R"("axisInterval":[1490000000,1510000000]},)"
+      R"("crossSpectrum":{"show":true},"bearing":{"show":false}},)"
+      R"("deviceState":{"fftSizeIdx":9,"gainChan0":12}})";
+
+  IChartState domState;
+  IDeviceState domDevice{};
+  double domNs = measureNs([&] {
+    auto req = json::parse(request);
+    if (req.contains("chartState"))
+      req.at("chartState").get_to(domState);
+    if (req.contains("deviceState"))
+      req.at("deviceState").get_to(domDevice);
+    doNotOptimize(domState);
+  });
+
+  IChartState saxState;
+  IControlMsg msg;
+  std::string error;
+  double saxNs = measureNs([&] {
+    msg = IControlMsg{};
+    parseControlMsg(request.data(), request.size(), msg, saxState, error);
+    doNotOptimize(saxState);
+  });
+
+  IDeviceState saxDevice{};
+  msg.deviceState.applyTo(saxDevice);
+  bool same = std::memcmp(&domState, &saxState, sizeof(IChartState)) == 0 &&
+              std::memcmp(&domDevice, &saxDevice, sizeof(IDeviceState)) == 0;
+  std::cout << "  " << request.size() << " bytes: DOM " << std::fixed
+            << std::setprecision(0) << domNs << " ns, SAX " << saxNs
+            << " ns" << (same ? "" : ", MISMATCH") << '\n';
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../client/frameDecoder.h"
+#include "../device_emulator/interfaces/IBinaryMsg.h"
+#include "bench_utils.hpp"
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <variant>
+#include <vector>
+
+// Zero-copy decoding of the samples and spectrum messages, checked against
+// the serializer; every truncated message must be rejected
+void decode_bench() {
+  std::cout << "decode_bench\n";
+  for (size_t size = 128; size <= 65536; size *= 8) {
+    // Clamped as DevEmulator::wireSize() does at the largest fftSize
+    auto sizeArray = static_cast<uint16_t>(std::min(size, kMaxSizeArray));
+    ISamplesChan samples{};
+    samples.code = 1;
+    samples.timeStep = 1e-6f;
+    samples.sizeArray = sizeArray;
+    samples.re.resize(sizeArray);
+    samples.im.resize(sizeArray);
+    for (size_t i = 0; i < sizeArray; i++) {
+      samples.re[i] = static_cast<int16_t>(i);
+      samples.im[i] = static_cast<int16_t>(-static_cast<int>(i));
+    }
+    samples.metadata = "{\"frame\":1}";
+    samples.sizeMetadata = static_cast<uint16_t>(samples.metadata.size());
+    auto encoded = samples.serialize();
+
+    IFrameView frame;
+    bool same = sizeArray % 2 == 0 &&
+                decodeFrame(encoded.data(), encoded.size(), frame);
+    if (auto view = std::get_if<ISamplesView>(&frame); same && view) {
+      same = view->code == 1 && view->timeStep == samples.timeStep &&
+             view->re.size() == sizeArray && view->im.size() == sizeArray &&
+             view->re[sizeArray - 1] == samples.re.back() &&
+             view->im[sizeArray - 1] == samples.im.back() &&
+             view->metadata == samples.metadata;
+    } else {
+      same = false;
+    }
+    // Only the first bytes, the cut inside the samples, and the whole tail
+    for (size_t cut : {size_t{0}, size_t{5}, encoded.size() / 2,
+                       encoded.size() - 1})
+      same = same && !decodeFrame(encoded.data(), cut, frame);
+
+    double ns = measureNs([&] {
+      decodeFrame(encoded.data(), encoded.size(), frame);
+      doNotOptimize(frame);
+    });
+    std::cout << "  size " << std::setw(6) << size << ": decode "
+              << std::setw(6) << std::fixed << std::setprecision(1) << ns
+              << " ns" << (same ? "" : ", MISMATCH") << '\n';
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "../device_emulator/dsp/crossSpectrum.h"
+#include "../device_emulator/dsp/fft.h"
+#include "../device_emulator/dsp/signalEngine.h"
+#include "bench_utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <complex>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Largest error of the FFT against a naive DFT in double precision, relative
+// to the largest bin. Every bin is checked up to 4096 points, a spread of 64
+// bins above, so that the check stays quick at the largest sizes.
+inline double fftError(size_t fftSize) {
+  std::vector<float> re(fftSize), im(fftSize), work(2 * fftSize);
+  uint32_t state = 1;
+  auto next = [&state] {
+    state = state * 1664525u + 1013904223u;
+    return static_cast<float>(state >> 8) / 16777216.0f - 0.5f;
+  };
+  for (size_t i = 0; i < fftSize; i++) {
+    re[i] = next();
+    im[i] = next();
+  }
+  std::vector<std::complex<double>> input(fftSize);
+  for (size_t i = 0; i < fftSize; i++)
+    input[i] = {re[i], im[i]};
+
+  Fft::get(fftSize).forward(re.data(), im.data(), work.data());
+
+  const double pi = std::acos(-1.0);
+  const size_t stride = std::max<size_t>(fftSize / 64, 1);
+  double maxError = 0, maxBin = 0;
+  for (size_t k = fftSize <= 4096 ? 0 : 7; k < fftSize;
+       k += fftSize <= 4096 ? 1 : stride) {
+    std::complex<double> sum;
+    for (size_t n = 0; n < fftSize; n++)
+      sum += input[n] * std::polar(1.0, -2 * pi *
+                                            static_cast<double>(k * n % fftSize) /
+                                            static_cast<double>(fftSize));
+    maxError = std::max(maxError, std::abs(sum - std::complex<double>(
+                                                     re[k], im[k])));
+    maxBin = std::max(maxBin, std::abs(sum));
+  }
+  return maxBin > 0 ? maxError / maxBin : maxError;
+}
+
+// Cost of one emulator frame of both channels: synthesis, window, FFT, dB,
+// and of the cross and phase spectra computed from them. The FFT is checked
+// against a naive DFT before it is timed.
+void dsp_bench() {
+  std::cout << "dsp_bench\n";
+  const float sampleRate = 30.72e6f;
+  const float gainDb[SignalEngine::kChannels] = {12, 15};
+
+  for (size_t fftSize = 128; fftSize <= 65536; fftSize *= 2) {
+    double error = fftError(fftSize);
+
+    std::vector<float> re(fftSize, 1.0f), im(fftSize), work(2 * fftSize);
+    const Fft &fft = Fft::get(fftSize);
+    double fftNs = measureNs([&] {
+      fft.forward(re.data(), im.data(), work.data());
+      doNotOptimize(re);
+    });
+
+    SignalEngine engine;
+    double frameNs = measureNs([&] {
+      engine.process(fftSize, sampleRate, gainDb);
+      doNotOptimize(engine.channel(0).spectrumDb);
+    });
+
+    CrossSpectrum cross;
+    cross.setAveraging(0.25f);
+    double crossNs = measureNs([&] {
+      cross.process(engine.channel(0), engine.channel(1), engine.refDb());
+      doNotOptimize(cross.phaseDeg());
+    });
+
+    std::cout << "  fftSize " << std::setw(6) << fftSize << ": FFT "
+              << std::setw(8) << std::fixed << std::setprecision(1)
+              << fftNs / 1000 << " us, 2 channels " << std::setw(8)
+              << frameNs / 1000 << " us, cross " << std::setw(7)
+              << crossNs / 1000 << " us (max " << std::setprecision(0)
+              << 1e9 / (frameNs + crossNs) << " frames/s), error "
+              << std::scientific << std::setprecision(1) << error
+              << (error < 1e-4 ? "" : ", MISMATCH") << '\n';
+  }
+}
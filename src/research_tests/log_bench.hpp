@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../server/logger.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+
+// Stream buffer that discards the text after it is formatted
+struct NullStreamBuf : std::streambuf {
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+// Cost of a log call on the calling thread: the asynchronous logger stages
+// the arguments, the former synchronous output formats under a lock. Both
+// write to a stream that discards the text.
+void log_bench() {
+  std::cout << "log_bench\n";
+  using clock = std::chrono::steady_clock;
+  const std::string cid = "0f8fad5b-d9cb-469f-a165-70867728950e";
+  NullStreamBuf nullBuf;
+  std::ostream null{&nullBuf};
+  auto &logger = Logger::instance();
+  logger.setSinks(null, null);
+  logger.setLevel(LogLevel::info);
+
+  // Batches small enough for the staging buffer, flushed between batches
+  constexpr size_t kBatch = 256;
+  auto batchedNs = [&](auto &&call) {
+    size_t calls = 0;
+    auto elapsed = clock::duration::zero();
+    while (elapsed < std::chrono::milliseconds(200)) {
+      auto start = clock::now();
+      for (size_t i = 0; i < kBatch; i++)
+        call(i);
+      elapsed += clock::now() - start;
+      calls += kBatch;
+      logger.flush();
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           static_cast<double>(calls);
+  };
+  double asyncNs = batchedNs([&](size_t i) {
+    logInfo("websocket_session ", cid, ": frames ", i, ", jitter ", 12.5);
+  });
+  double filteredNs =
+      batchedNs([](size_t) { logDebug("Create http_session"); });
+
+  std::mutex mtx;
+  double syncNs = batchedNs([&](size_t i) {
+    std::lock_guard lock{mtx};
+    null << "websocket_session " << cid << ": frames " << i << ", jitter "
+         << 12.5 << "\n";
+  });
+
+  logger.setSinks(std::cout, std::cerr);
+  std::cout << "  async " << std::fixed << std::setprecision(1) << asyncNs
+            << " ns, below the level " << filteredNs << " ns, synchronous "
+            << syncNs << " ns\n";
+}
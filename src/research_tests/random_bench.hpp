@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../device_emulator/helpers/fastRandom.h"
+#include "bench_utils.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Former getRandomData: new std::random_device and std::mt19937 per call
+template <typename T>
+std::vector<T> getRandomDataMt19937(float min, float max, size_t size) {
+  std::random_device rnd_device;
+  std::mt19937 mersenne_engine{rnd_device()};
+  std::uniform_real_distribution<float> dist{min, max};
+
+  auto gen = [&]() { return dist(mersenne_engine); };
+
+  std::vector<T> vec(size);
+  std::generate(vec.begin(), vec.end(), gen);
+
+  return vec;
+}
+
+template <typename T> void random_bench_type(const char *typeName) {
+  std::cout << "  " << typeName << '\n';
+  for (size_t fftSize = 128; fftSize <= 65536; fftSize *= 2) {
+    double oldNs = measureNs([&] {
+      auto vec = getRandomDataMt19937<T>(-1000, 1000, fftSize);
+      doNotOptimize(vec);
+    });
+
+    std::vector<T> vec(fftSize);
+    double newNs = measureNs([&] {
+      FastRandom::local().fill(vec, -1000, 1000);
+      doNotOptimize(vec);
+    });
+
+    std::cout << "    fftSize " << std::setw(6) << fftSize << ": mt19937 "
+              << std::setw(10) << std::fixed << std::setprecision(0) << oldNs
+              << " ns, FastRandom " << std::setw(8) << newNs << " ns, x"
+              << std::setprecision(1) << oldNs / newNs << '\n';
+  }
+}
+
+// Compares the former getRandomData with FastRandom::fill
+void random_bench() {
+  std::cout << "random_bench\n";
+  random_bench_type<int8_t>("int8_t");
+  random_bench_type<int16_t>("int16_t");
+  random_bench_type<float>("float");
+}
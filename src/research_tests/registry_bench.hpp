@@ -0,0 +1,104 @@
+#pragma once
+
+#include "../server/clientRegistry.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Broadcast over 10k registered clients while other threads keep connecting
+// and disconnecting clients. Every lock() that succeeds must give a live
+// session. A connect must not rebuild the snapshot: the churn must reach
+// kMinChurn connect+disconnect/s, and a broadcast during the churn, which
+// rebuilds the snapshot once for all the connects since the previous one,
+// must stay within kMaxChurnSlowdown of a quiet one.
+void registry_bench() {
+  std::cout << "registry_bench\n";
+  using clock = std::chrono::steady_clock;
+
+  struct Session {
+    ~Session() { alive = false; }
+    std::atomic<bool> alive{true};
+    uint64_t received = 0;
+  };
+
+  constexpr size_t kClients = 10000;
+  constexpr int kChurnThreads = 2;
+  constexpr double kMinChurn = 10000;
+  constexpr double kMaxChurnSlowdown = 5;
+  ClientRegistry<Session> registry;
+  std::vector<std::shared_ptr<Session>> sessions;
+  for (size_t i = 0; i < kClients; i++) {
+    sessions.push_back(std::make_shared<Session>());
+    registry.add(sessions.back());
+  }
+
+  // One pass of the frame: send to every client of the snapshot
+  bool consistent = true;
+  auto broadcast = [&] {
+    auto clients = registry.snapshot();
+    size_t sent = 0;
+    for (auto &weak : *clients) {
+      if (auto session = weak.lock()) {
+        consistent = consistent && session->alive;
+        session->received++;
+        sent++;
+      }
+    }
+    return sent;
+  };
+  auto measure = [&](std::chrono::milliseconds time, size_t &passes) {
+    passes = 0;
+    auto start = clock::now();
+    while (clock::now() - start < time) {
+      broadcast();
+      passes++;
+    }
+    return std::chrono::duration<double, std::micro>(clock::now() - start)
+               .count() /
+           static_cast<double>(passes);
+  };
+
+  size_t passes = 0;
+  double quietUs = measure(std::chrono::milliseconds(200), passes);
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> churned{0};
+  std::vector<std::thread> churn;
+  for (int t = 0; t < kChurnThreads; t++) {
+    churn.emplace_back([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto session = std::make_shared<Session>();
+        registry.add(session);
+        session.reset();
+        registry.remove();
+        churned.fetch_add(1, std::memory_order_relaxed);
+        // A connection storm, not a busy loop on the registry lock
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+      }
+    });
+  }
+  auto churnStart = clock::now();
+  double churnUs = measure(std::chrono::milliseconds(500), passes);
+  stop = true;
+  for (auto &thread : churn)
+    thread.join();
+  double seconds =
+      std::chrono::duration<double>(clock::now() - churnStart).count();
+
+  // Every open session remains; the closed ones left in the snapshot are
+  // fewer than the live entries
+  bool complete = broadcast() == kClients &&
+                  registry.snapshot()->size() < 2 * kClients + 2;
+  double churnRate = static_cast<double>(churned) / seconds;
+  bool fast = churnRate >= kMinChurn && churnUs <= kMaxChurnSlowdown * quietUs;
+  std::cout << "  " << kClients << " clients: broadcast " << std::fixed
+            << std::setprecision(1) << quietUs << " us, during churn "
+            << churnUs << " us; " << churnRate << " connect+disconnect/s"
+            << (consistent && complete ? "" : ", INCONSISTENT")
+            << (fast ? "" : ", SLOW") << '\n';
+}
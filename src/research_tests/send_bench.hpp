@@ -0,0 +1,227 @@
+#pragma once
+
+#include "../server/sendInbox.h"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace sendBench {
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+using tcp = net::ip::tcp;
+using Message = std::shared_ptr<const std::string>;
+using Stream = websocket::stream<beast::tcp_stream>;
+
+// The former write path: the sending thread locks the queue and starts the
+// write itself, the completion locks it again to start the next one
+class MutexSession : public std::enable_shared_from_this<MutexSession> {
+public:
+  explicit MutexSession(Stream &&ws) : ws_{std::move(ws)} {}
+
+  void send(Message message) {
+    std::lock_guard lock{mtx_};
+    queue_.push_back(std::move(message));
+    if (queue_.size() == 1)
+      doWrite();
+  }
+
+private:
+  void doWrite() {
+    ws_.async_write(net::buffer(*queue_.front()),
+                    beast::bind_front_handler(&MutexSession::onWrite,
+                                              shared_from_this()));
+  }
+  void onWrite(beast::error_code ec, size_t) {
+    std::lock_guard lock{mtx_};
+    if (ec)
+      return;
+    queue_.pop_front();
+    if (!queue_.empty())
+      doWrite();
+  }
+
+  Stream ws_;
+  std::mutex mtx_;
+  std::deque<Message> queue_;
+};
+
+// The strand write path of websocket_session: the sending thread only
+// pushes to the inbox, the strand drains it and writes back-to-back
+class InboxSession : public std::enable_shared_from_this<InboxSession> {
+public:
+  explicit InboxSession(Stream &&ws) : ws_{std::move(ws)} {}
+
+  void send(Message message) {
+    if (inbox_.push(std::move(message)))
+      net::post(ws_.get_executor(),
+                beast::bind_front_handler(&InboxSession::onInbox,
+                                          shared_from_this()));
+  }
+
+  size_t wakeups = 0; // On the strand
+
+private:
+  void onInbox() {
+    wakeups++;
+    bool idle = queue_.empty();
+    inbox_.drain(
+        [&](Message &&message) { queue_.push_back(std::move(message)); });
+    if (idle)
+      doWrite();
+  }
+  void doWrite() {
+    ws_.async_write(net::buffer(*queue_.front()),
+                    beast::bind_front_handler(&InboxSession::onWrite,
+                                              shared_from_this()));
+  }
+  void onWrite(beast::error_code ec, size_t) {
+    if (ec)
+      return;
+    queue_.pop_front();
+    if (!queue_.empty())
+      doWrite();
+  }
+
+  Stream ws_;
+  SendInbox<Message> inbox_;
+  std::deque<Message> queue_; // On the strand
+};
+
+struct IRun {
+  double messagesPerSecond = 0;
+  double sendNs = 0;  // Time of a send() on the producer thread
+  size_t wakeups = 0; // Drains of the inbox
+};
+
+// `producers` threads send `count` small binary messages to one session
+// over loopback, a blocking client reads them. Timed until the last message
+// is read. A paced producer sends the next message once the client has read
+// the previous one, as a frame thread does for a client that keeps up: the
+// queue is idle at every send().
+template <typename Session>
+IRun run(size_t count, size_t size, int producers, bool paced = false) {
+  net::io_context ioc;
+  tcp::acceptor acceptor{ioc, {net::ip::make_address("127.0.0.1"), 0}};
+  auto port = acceptor.local_endpoint().port();
+
+  std::chrono::steady_clock::time_point done;
+  std::atomic<size_t> received{0};
+  std::thread reader([&, port] {
+    net::io_context clientIoc;
+    websocket::stream<tcp::socket> client{clientIoc};
+    client.next_layer().connect({net::ip::make_address("127.0.0.1"), port});
+    client.handshake("127.0.0.1", "/");
+    beast::flat_buffer buffer;
+    for (size_t i = 0; i < count; i++) {
+      client.read(buffer);
+      buffer.consume(buffer.size());
+      received.store(i + 1, std::memory_order_release);
+    }
+    done = std::chrono::steady_clock::now();
+    beast::error_code ec;
+    client.next_layer().close(ec);
+  });
+
+  Stream ws{net::make_strand(ioc)};
+  acceptor.accept(beast::get_lowest_layer(ws).socket());
+  ws.accept();
+  ws.binary(true);
+  auto session = std::make_shared<Session>(std::move(ws));
+  std::thread io([&] {
+    auto work = net::make_work_guard(ioc);
+    ioc.run();
+  });
+
+  auto message = std::make_shared<const std::string>(size, 'x');
+  std::atomic<int64_t> sendingNs{0};
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < producers; t++) {
+    threads.emplace_back([&, t] {
+      using clock = std::chrono::steady_clock;
+      size_t share = count / producers + (t == 0 ? count % producers : 0);
+      auto elapsed = clock::duration::zero();
+      if (!paced) {
+        auto begin = clock::now();
+        for (size_t i = 0; i < share; i++)
+          session->send(message);
+        elapsed = clock::now() - begin;
+      }
+      for (size_t i = 0; paced && i < share; i++) {
+        auto begin = clock::now();
+        session->send(message);
+        elapsed += clock::now() - begin;
+        while (received.load(std::memory_order_acquire) <= i)
+          std::this_thread::yield();
+      }
+      sendingNs.fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+              .count());
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  reader.join();
+  ioc.stop();
+  io.join();
+
+  IRun result;
+  result.messagesPerSecond =
+      static_cast<double>(count) /
+      std::chrono::duration<double>(done - start).count();
+  result.sendNs =
+      static_cast<double>(sendingNs.load()) / static_cast<double>(count);
+  if constexpr (std::is_same_v<Session, InboxSession>)
+    result.wakeups = session->wakeups;
+  return result;
+}
+
+} // namespace sendBench
+
+// Messages per second through one session, from the send() of the producer
+// threads to the reading client, and the time a send() holds the producer:
+// the former mutex path against the inbox drained on the strand of the
+// session
+void send_bench() {
+  std::cout << "send_bench\n";
+  using namespace sendBench;
+  constexpr size_t kMessages = 100000;
+  constexpr size_t kSize = 64;
+  auto print = [&](const char *title, const IRun &before,
+                   const IRun &after) {
+    std::cout << "  " << title << ", " << kMessages << " x " << kSize
+              << " B\n"
+              << std::fixed << std::setprecision(0) << "    mutex:        "
+              << before.messagesPerSecond << " msg/s, send() "
+              << before.sendNs << " ns\n"
+              << "    strand inbox: " << after.messagesPerSecond
+              << " msg/s, send() " << after.sendNs << " ns, "
+              << std::setprecision(1)
+              << static_cast<double>(kMessages) /
+                     static_cast<double>(after.wakeups)
+              << " messages per wakeup\n";
+  };
+  print("1 producer", run<MutexSession>(kMessages, kSize, 1),
+        run<InboxSession>(kMessages, kSize, 1));
+  print("4 producers", run<MutexSession>(kMessages, kSize, 4),
+        run<InboxSession>(kMessages, kSize, 4));
+  print("1 producer, paced", run<MutexSession>(kMessages, kSize, 1, true),
+        run<InboxSession>(kMessages, kSize, 1, true));
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../device_emulator/helpers/framePayload.h"
+#include "../device_emulator/interfaces/IBinaryMsg.h"
+#include "bench_utils.hpp"
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Former serializer: one push_back per byte into an empty vector
+inline void serializeFieldBytewise(std::vector<char> &buff, const char *ptr,
+                                   size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    buff.push_back(ptr[i]);
+  }
+}
+
+inline std::vector<char> serializeSamplesBytewise(const ISamplesChan &msg) {
+  std::vector<char> buff;
+  serializeFieldBytewise(buff, (const char *)&msg.code, sizeof(msg.code));
+  serializeFieldBytewise(buff, (const char *)&msg.timeStart,
+                         sizeof(msg.timeStart));
+  serializeFieldBytewise(buff, (const char *)&msg.timeStep,
+                         sizeof(msg.timeStep));
+  serializeFieldBytewise(buff, (const char *)&msg.sizeArray,
+                         sizeof(msg.sizeArray));
+  serializeFieldBytewise(buff, (const char *)&msg.emptyByte,
+                         sizeof(msg.emptyByte));
+  serializeFieldBytewise(buff, (const char *)msg.re.data(),
+                         sizeof(int16_t) * msg.re.size());
+  serializeFieldBytewise(buff, (const char *)msg.im.data(),
+                         sizeof(int16_t) * msg.im.size());
+  serializeFieldBytewise(buff, (const char *)&msg.sizeMetadata,
+                         sizeof(msg.sizeMetadata));
+  serializeFieldBytewise(buff, msg.metadata.data(), msg.metadata.size());
+  return buff;
+}
+
+// Samples message serialization: the former byte-wise serializer, the layout
+// serializer with its own allocation, serializeInto a reused buffer, and the
+// gather message that references the samples instead of copying them
+void serialize_bench() {
+  std::cout << "serialize_bench\n";
+  for (size_t size = 128; size <= 65536; size *= 2) {
+    ISamplesChan msg;
+    msg.code = 0;
+    msg.timeStart = 0;
+    msg.timeStep = 1e-6f;
+    // Clamped as DevEmulator::wireSize() does at the largest fftSize
+    msg.sizeArray = static_cast<uint16_t>(std::min(size, kMaxSizeArray));
+    msg.emptyByte = 0;
+    msg.re.resize(msg.sizeArray);
+    msg.im.resize(msg.sizeArray);
+    for (size_t i = 0; i < msg.re.size(); i++) {
+      msg.re[i] = static_cast<int16_t>(i);
+      msg.im[i] = static_cast<int16_t>(-static_cast<int>(i));
+    }
+    msg.metadata = "{\"frame\":1}";
+    msg.sizeMetadata = static_cast<uint16_t>(msg.metadata.size());
+
+    auto reference = serializeSamplesBytewise(msg);
+    bool same = msg.sizeArray % 2 == 0 && reference == msg.serialize();
+    ISamplesChan decoded;
+    same = same &&
+           ISamplesChanLayout::deserialize(decoded, reference.data(),
+                                           reference.size()) &&
+           decoded.re == msg.re && decoded.im == msg.im &&
+           decoded.metadata == msg.metadata;
+
+    double oldNs = measureNs([&] {
+      auto buff = serializeSamplesBytewise(msg);
+      doNotOptimize(buff);
+    });
+    double newNs = measureNs([&] {
+      auto buff = msg.serialize();
+      doNotOptimize(buff);
+    });
+    std::vector<char> buff(ISamplesChanLayout::encodedSize(msg));
+    double intoNs = measureNs([&] {
+      ISamplesChanLayout::serializeInto(msg, buff.data(), buff.size());
+      doNotOptimize(buff);
+    });
+
+    auto re = std::make_shared<const std::vector<int16_t>>(msg.re);
+    auto im = std::make_shared<const std::vector<int16_t>>(msg.im);
+    ISamplesChan header = msg;
+    IDemand demand;
+    demand.metadata = true;
+    auto gather = makeSamplesPayload(header, re, im, demand, msg.metadata);
+    std::vector<char> joined(gather.withMetadata.size());
+    boost::asio::buffer_copy(boost::asio::buffer(joined),
+                             gather.withMetadata.buffers);
+    same = same && joined == reference;
+    double gatherNs = measureNs([&] {
+      auto payload = makeSamplesPayload(header, re, im, demand, msg.metadata);
+      doNotOptimize(payload);
+    });
+
+    // Bytes per ns is GB/s
+    auto bytes = static_cast<double>(reference.size());
+    std::cout << "  size " << std::setw(6) << size << ": bytewise "
+              << std::setw(6) << std::fixed << std::setprecision(2)
+              << bytes / oldNs << " GB/s, serialize " << std::setw(6)
+              << bytes / newNs << " GB/s, serializeInto " << std::setw(6)
+              << bytes / intoNs << " GB/s, gather " << std::setw(8)
+              << bytes / gatherNs << " GB/s" << (same ? "" : ", MISMATCH")
+              << '\n';
+  }
+}
@@ -1,13 +1,18 @@
 #pragma once
 
+#include "../device_emulator/helpers/framePayload.h"
 #include "../device_emulator/interfaces/IJsonMsg.h"
+#include <memory>
 #include <vector>
 
 class websocket_session;
 
+// Client of the current frame
 struct IClient {
+  // Сессия, удерживаемая до конца фрейма
+  std::shared_ptr<websocket_session> ws;
+  // Снимок настроек графиков для текущего фрейма
   IChartState chartState;
-  websocket_session *ws;
+  // Сообщения текущего фрейма, ожидающие отправки одной посылкой
+  std::vector<IGatherMessage> batch;
 };
-
-extern std::vector<IClient> clientList;
\ No newline at end of file
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Sessions subscribed to a device, read by the broadcasts while the io
+// threads connect and disconnect clients.
+//
+// The broadcasts iterate an immutable snapshot. Without a pending change,
+// taking one is a load of the change counters and a single atomic fetch_add
+// on the published word, which names the current snapshot and counts the
+// readers pinning it; letting it go is a fetch_sub on the snapshot's
+// counter.
+//
+// add() only queues the session and returns. The first snapshot() after a
+// change builds the next vector (copy-on-write, RCU style) once for every
+// session queued so far, from the current snapshot and the pending ones,
+// and publishes it in a free slot: N connects between two frames cost one
+// rebuild. A session is in every snapshot taken after its add() has
+// returned. remove() only counts the expired entry, which the broadcasts
+// skip anyway; the snapshot is rebuilt without them once they make up half
+// of it. The readers counted in the replaced word are handed to the retired
+// slot, which is reused once they all have let it go: that is the grace
+// period. Only a writer that finds every slot pinned waits for one. The
+// sessions are held by weak_ptr: a session that is closing is skipped by
+// lock(), never dereferenced, and is dropped from the next snapshot.
+template <typename Session> class ClientRegistry {
+public:
+  using Snapshot = std::vector<std::weak_ptr<Session>>;
+
+  // A pinned snapshot, valid until the View is destroyed. Hold it for one
+  // broadcast, not across waits: a writer may need its slot.
+  class View {
+  public:
+    View(const View &) = delete;
+    View &operator=(const View &) = delete;
+    View(View &&other) noexcept
+        : registry_{other.registry_}, slot_{other.slot_} {
+      other.registry_ = nullptr;
+    }
+    ~View() {
+      if (registry_)
+        registry_->unpin(slot_);
+    }
+
+    const Snapshot &operator*() const { return registry_->slots_[slot_].data; }
+    const Snapshot *operator->() const {
+      return &registry_->slots_[slot_].data;
+    }
+
+  private:
+    friend class ClientRegistry;
+    View(const ClientRegistry *registry, size_t slot)
+        : registry_{registry}, slot_{slot} {}
+
+    const ClientRegistry *registry_;
+    size_t slot_;
+  };
+
+  ClientRegistry() { slots_[0].used = true; }
+  ClientRegistry(const ClientRegistry &) = delete;
+  ClientRegistry &operator=(const ClientRegistry &) = delete;
+
+  void add(std::weak_ptr<Session> session) {
+    std::lock_guard lock{pendingMtx_};
+    pending_.push_back(std::move(session));
+    // seq_cst: a broadcast that follows a change the caller makes after
+    // add(), such as a log append, sees the session pending
+    requested_.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  // Called when a session is destroyed: its weak_ptr has already expired
+  void remove() {
+    auto expired = expired_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (expired * 2 > size_.load(std::memory_order_relaxed)) {
+      {
+        std::lock_guard lock{pendingMtx_};
+        requested_.fetch_add(1, std::memory_order_seq_cst);
+      }
+      publish();
+    }
+  }
+
+  // Sessions registered so far; entries of closed sessions fail to lock.
+  // Publishes the pending changes first, if any.
+  View snapshot() {
+    if (requested_.load(std::memory_order_seq_cst) !=
+        published_.load(std::memory_order_acquire))
+      publish();
+    auto word = current_.fetch_add(1, std::memory_order_acquire);
+    return View{this, static_cast<size_t>(word >> kSlotShift)};
+  }
+
+private:
+  static constexpr size_t kSlots = 16;
+  // The published word: slot << kSlotShift | readers pinned since published
+  static constexpr unsigned kSlotShift = 48;
+  static constexpr uint64_t kPinsMask = (uint64_t{1} << kSlotShift) - 1;
+
+  struct ISlot {
+    Snapshot data;
+    // Released pins, and the acquired ones added when the slot is retired:
+    // 0 after the retirement means no reader is left
+    mutable std::atomic<int64_t> pins{0};
+    bool used = false; // Under writeMtx_: current, or retired and pinned
+  };
+
+  void unpin(size_t slot) const {
+    slots_[slot].pins.fetch_sub(1, std::memory_order_release);
+  }
+
+  // Build and publish a snapshot with every change recorded so far. The
+  // callers that queue behind the one rebuilding find nothing left to do.
+  void publish() {
+    std::lock_guard lock{writeMtx_};
+    uint64_t requested;
+    std::vector<std::weak_ptr<Session>> added;
+    {
+      std::lock_guard pendingLock{pendingMtx_};
+      requested = requested_.load(std::memory_order_relaxed);
+      if (requested == published_.load(std::memory_order_relaxed))
+        return;
+      added.swap(pending_);
+    }
+    // A session closed from here on may be dropped now and counted again
+    expired_.store(0, std::memory_order_relaxed);
+
+    // The current slot is never changed while it is published
+    auto previous = static_cast<size_t>(
+        current_.load(std::memory_order_relaxed) >> kSlotShift);
+    auto slot = freeSlot();
+    auto &next = slots_[slot].data;
+    next.clear();
+    next.reserve(slots_[previous].data.size() + added.size());
+    for (auto &session : slots_[previous].data) {
+      if (!session.expired())
+        next.push_back(session);
+    }
+    for (auto &session : added) {
+      if (!session.expired())
+        next.push_back(std::move(session));
+    }
+    slots_[slot].pins.store(0, std::memory_order_relaxed);
+    slots_[slot].used = true;
+    size_.store(next.size(), std::memory_order_relaxed);
+
+    auto word = current_.exchange(uint64_t{slot} << kSlotShift,
+                                  std::memory_order_acq_rel);
+    slots_[previous].pins.fetch_add(static_cast<int64_t>(word & kPinsMask),
+                                    std::memory_order_relaxed);
+    published_.store(requested, std::memory_order_release);
+  }
+
+  // A slot no reader can reach, under writeMtx_
+  size_t freeSlot() {
+    while (true) {
+      for (size_t i = 0; i < kSlots; i++) {
+        auto &slot = slots_[i];
+        bool current =
+            (current_.load(std::memory_order_relaxed) >> kSlotShift) == i;
+        if (slot.used && !current &&
+            slot.pins.load(std::memory_order_acquire) == 0)
+          slot.used = false;
+        if (!slot.used)
+          return i;
+      }
+      // Every retired snapshot is still being iterated
+      std::this_thread::yield();
+    }
+  }
+
+  std::mutex pendingMtx_;
+  std::vector<std::weak_ptr<Session>> pending_; // Under pendingMtx_
+  std::mutex writeMtx_;                         // One rebuild at a time
+  std::atomic<uint64_t> requested_{0}; // Changes recorded, under pendingMtx_
+  std::atomic<uint64_t> published_{0}; // Changes in the current snapshot
+  std::atomic<size_t> expired_{0}; // Closed sessions in the current snapshot
+  std::atomic<size_t> size_{0};    // Entries of the current snapshot
+  std::array<ISlot, kSlots> slots_;
+  std::atomic<uint64_t> current_{0}; // Slot 0, no readers
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+// Whether the sessions offer permessage-deflate. Beast has no per-message
+// switch: once a client negotiates the extension, every message of the
+// stream is deflated, including the int16 samples that barely compress, and
+// each session deflates its own copy of the shared frames. So the only
+// policies are none or all; compress_bench tells whether all pays off.
+enum class CompressionPolicy {
+  off, // permessage-deflate is not offered
+  all  // offered, every message of a client that accepts it is compressed
+};
+
+// Set at startup from the server options
+extern CompressionPolicy compressionPolicy;
@@ -0,0 +1,177 @@
+#include "logger.h"
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// The flusher writes the staged records this often
+constexpr auto kFlushPeriod = std::chrono::milliseconds(20);
+// Shortest interval that gives the tick length, a shorter one is noisy
+constexpr int64_t kCalibrationNs = 1000000;
+
+int64_t systemNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+const char *levelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::debug:
+    return "debug";
+  case LogLevel::info:
+    return "info";
+  case LogLevel::warning:
+    return "warning";
+  case LogLevel::error:
+    return "error";
+  }
+  return "";
+}
+
+// Formatted record waiting to be written
+struct ILine {
+  int64_t time;
+  LogLevel level;
+  std::string text;
+};
+
+// "12:34:56.789"
+void printTime(std::ostream &os, int64_t time) {
+  auto seconds = static_cast<std::time_t>(time / 1000000000);
+  auto millis = (time / 1000000) % 1000;
+  // Called by one thread at a time, under the mutex of the logger
+  std::tm local = *std::localtime(&seconds);
+  os << std::put_time(&local, "%H:%M:%S") << '.' << std::setw(3)
+     << std::setfill('0') << millis << std::setfill(' ');
+}
+
+} // namespace
+
+bool parseLogLevel(std::string_view name, LogLevel &level) {
+  for (auto value : {LogLevel::debug, LogLevel::info, LogLevel::warning,
+                     LogLevel::error}) {
+    if (name == levelName(value)) {
+      level = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+Logger &Logger::instance() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger() : out_{&std::cout}, err_{&std::cerr} {
+  // A first tick length for the records logged before the first flush
+  calTicks_ = logDetail::ticks();
+  calTime_ = systemNs();
+  while (systemNs() - calTime_ < kCalibrationNs) {
+  }
+  calibrate();
+  thread_ = std::thread{[this] { run(); }};
+}
+
+Logger::~Logger() {
+  {
+    std::lock_guard lock{mtx_};
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+void Logger::setSinks(std::ostream &out, std::ostream &err) {
+  std::lock_guard lock{mtx_};
+  drain();
+  out_ = &out;
+  err_ = &err;
+}
+
+void Logger::flush() {
+  std::lock_guard lock{mtx_};
+  drain();
+}
+
+std::shared_ptr<logDetail::StagingBuffer> Logger::addBuffer() {
+  auto buffer = std::make_shared<logDetail::StagingBuffer>();
+  std::lock_guard lock{mtx_};
+  buffers_.push_back(buffer);
+  return buffer;
+}
+
+void Logger::run() {
+  std::unique_lock lock{mtx_};
+  while (!stop_) {
+    wake_.wait_for(lock, kFlushPeriod, [this] { return stop_; });
+    drain();
+  }
+}
+
+void Logger::calibrate() {
+  auto ticks = logDetail::ticks();
+  auto time = systemNs();
+  if (time - calTime_ < kCalibrationNs || ticks <= calTicks_)
+    return;
+  nsPerTick_ = static_cast<double>(time - calTime_) /
+               static_cast<double>(ticks - calTicks_);
+  calTicks_ = ticks;
+  calTime_ = time;
+}
+
+void Logger::drain() {
+  // The records were staged since the previous calibration, the tick length
+  // measured over that interval places them in it
+  calibrate();
+  std::vector<ILine> lines;
+  uint64_t dropped = 0;
+  std::ostringstream text;
+  for (auto &buffer : buffers_) {
+    // The buffer of a finished thread is released once it is empty
+    bool finished = buffer.use_count() == 1;
+    buffer->drain([&](const logDetail::IRecordHeader &header,
+                      const char *args) {
+      text.str({});
+      header.format(text, args);
+      auto time = calTime_ + static_cast<int64_t>(
+                                 static_cast<double>(header.ticks - calTicks_) *
+                                 nsPerTick_);
+      lines.push_back({time, header.level, text.str()});
+    });
+    dropped += buffer->takeDropped();
+    if (finished)
+      buffer.reset();
+  }
+  buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), nullptr),
+                 buffers_.end());
+
+  // The threads are drained one after another, the lines are merged by time
+  std::stable_sort(lines.begin(), lines.end(),
+                   [](const ILine &a, const ILine &b) {
+                     return a.time < b.time;
+                   });
+  bool outUsed = false;
+  bool errUsed = false;
+  for (auto &line : lines) {
+    if (!line.text.empty() && line.text.back() == '\n')
+      line.text.pop_back();
+    bool isError = line.level >= LogLevel::warning;
+    auto &os = isError ? *err_ : *out_;
+    printTime(os, line.time);
+    os << ' ' << levelName(line.level) << ": " << line.text << '\n';
+    (isError ? errUsed : outUsed) = true;
+  }
+  if (dropped) {
+    *err_ << dropped << " log records dropped: the flusher fell behind\n";
+    errUsed = true;
+  }
+  if (outUsed)
+    out_->flush();
+  if (errUsed)
+    err_->flush();
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum class LogLevel : uint8_t { debug, info, warning, error };
+
+// "debug", "info", "warning" or "error"
+bool parseLogLevel(std::string_view name, LogLevel &level);
+
+namespace logDetail {
+
+// Timestamp of a record: the time stamp counter where the CPU has one, a
+// few ns against tens for system_clock. The flusher converts it to the
+// system time.
+inline int64_t ticks() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||              \
+    defined(__i386__)
+  return static_cast<int64_t>(__rdtsc());
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Formats the arguments of a record, returns the end of the arguments
+using FormatFn = const char *(*)(std::ostream &os, const char *args);
+
+// Start of a staged record, followed by the arguments
+struct IRecordHeader {
+  uint32_t size;   // Размер записи с аргументами, кратен 8 байтам
+  LogLevel level;  // Уровень
+  int64_t ticks;   // Время записи, logDetail::ticks()
+  FormatFn format; // nullptr - пропуск до конца буфера
+};
+
+// Staging of an argument of a log call: the value is copied as it is and
+// formatted by the flusher thread. Strings are copied with their length.
+template <typename T> struct Arg {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "a log argument must be a string or trivially copyable");
+
+  static size_t size(const T &) { return sizeof(T); }
+  static char *write(char *dst, const T &value) {
+    std::memcpy(dst, &value, sizeof(T));
+    return dst + sizeof(T);
+  }
+  static const char *print(std::ostream &os, const char *src) {
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    os << value;
+    return src + sizeof(T);
+  }
+};
+
+struct TextArg {
+  static size_t size(std::string_view text) {
+    return sizeof(uint32_t) + text.size();
+  }
+  static char *write(char *dst, std::string_view text) {
+    auto length = static_cast<uint32_t>(text.size());
+    std::memcpy(dst, &length, sizeof(length));
+    std::memcpy(dst + sizeof(length), text.data(), length);
+    return dst + sizeof(length) + length;
+  }
+  static const char *print(std::ostream &os, const char *src) {
+    uint32_t length;
+    std::memcpy(&length, src, sizeof(length));
+    os.write(src + sizeof(length), length);
+    return src + sizeof(length) + length;
+  }
+};
+
+template <> struct Arg<const char *> : TextArg {};
+template <> struct Arg<char *> : TextArg {};
+template <> struct Arg<std::string> : TextArg {};
+template <> struct Arg<std::string_view> : TextArg {};
+
+template <typename... Args>
+const char *format(std::ostream &os, const char *args) {
+  ((args = Arg<Args>::print(os, args)), ...);
+  return args;
+}
+
+// Records of one thread waiting for the flusher. Single producer, the
+// owning thread, and single consumer, the flusher.
+class StagingBuffer {
+public:
+  static constexpr size_t kCapacity = 64 * 1024;
+
+  StagingBuffer() : data_{std::make_unique<uint64_t[]>(kCapacity / 8)} {}
+
+  // Space for a record of `size` bytes, a multiple of 8, or nullptr if the
+  // flusher has not taken enough records yet
+  char *reserve(size_t size) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t offset = head % kCapacity;
+    // A record is never split: the end of the buffer is skipped
+    size_t skip = offset + size > kCapacity ? kCapacity - offset : 0;
+    size_t used = head - tail_.load(std::memory_order_acquire);
+    if (skip + size > kCapacity - used)
+      return nullptr;
+    if (skip >= sizeof(IRecordHeader)) {
+      IRecordHeader pad{static_cast<uint32_t>(skip), LogLevel::debug, 0,
+                        nullptr};
+      std::memcpy(bytes() + offset, &pad, sizeof(pad));
+    }
+    reserved_ = skip + size;
+    return bytes() + (head + skip) % kCapacity;
+  }
+  // Publish the record written to the reserved space
+  void commit() {
+    head_.store(head_.load(std::memory_order_relaxed) + reserved_,
+                std::memory_order_release);
+  }
+  void drop() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+
+  // Flusher side: onRecord(header, args) for each published record
+  template <typename OnRecord> void drain(OnRecord onRecord) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    while (tail != head) {
+      size_t offset = tail % kCapacity;
+      if (kCapacity - offset < sizeof(IRecordHeader)) {
+        tail += kCapacity - offset;
+        continue;
+      }
+      IRecordHeader header;
+      std::memcpy(&header, bytes() + offset, sizeof(header));
+      if (header.format)
+        onRecord(header, bytes() + offset + sizeof(header));
+      tail += header.size;
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+  // Records dropped since the previous call, flusher side
+  uint64_t takeDropped() {
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    uint64_t count = dropped - reportedDrops_;
+    reportedDrops_ = dropped;
+    return count;
+  }
+
+private:
+  char *bytes() { return reinterpret_cast<char *>(data_.get()); }
+
+  std::unique_ptr<uint64_t[]> data_; // uint64_t for the record alignment
+  std::atomic<size_t> head_{0};      // Bytes published by the producer
+  std::atomic<size_t> tail_{0};      // Bytes taken by the flusher
+  size_t reserved_ = 0;              // Producer only
+  std::atomic<uint64_t> dropped_{0}; // Written by the producer only
+  uint64_t reportedDrops_ = 0;       // Flusher only
+};
+
+} // namespace logDetail
+
+// Asynchronous logger. A log call copies its arguments into a buffer of the
+// calling thread, without a lock or an allocation, and returns; a background
+// thread formats the records and writes them out every few milliseconds.
+// When a thread logs faster than the flusher writes, its records are
+// dropped and the number of lost records is reported.
+class Logger {
+public:
+  static Logger &instance();
+  // Write out the remaining records and stop the flusher thread
+  ~Logger();
+
+  bool enabled(LogLevel level) const {
+    return level >= level_.load(std::memory_order_relaxed);
+  }
+  void setLevel(LogLevel level) {
+    level_.store(level, std::memory_order_relaxed);
+  }
+  // Streams of the info and debug records and of the warnings and errors,
+  // std::cout and std::cerr by default
+  void setSinks(std::ostream &out, std::ostream &err);
+  // Write out everything logged so far, waiting for it
+  void flush();
+
+  // The arguments are printed one after another like with operator<<
+  template <typename... Args> void write(LogLevel level, const Args &...args) {
+    if (!enabled(level))
+      return;
+    using logDetail::Arg;
+    using logDetail::IRecordHeader;
+    size_t size = sizeof(IRecordHeader) +
+                  (size_t{0} + ... + Arg<std::decay_t<Args>>::size(args));
+    size = (size + 7) & ~size_t{7};
+
+    auto &buffer = localBuffer();
+    char *dst = buffer.reserve(size);
+    if (!dst) {
+      buffer.drop();
+      return;
+    }
+    IRecordHeader header{static_cast<uint32_t>(size), level,
+                         logDetail::ticks(),
+                         &logDetail::format<std::decay_t<Args>...>};
+    std::memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    ((dst = Arg<std::decay_t<Args>>::write(dst, args)), ...);
+    buffer.commit();
+  }
+
+private:
+  Logger();
+
+  logDetail::StagingBuffer &localBuffer() {
+    thread_local std::shared_ptr<logDetail::StagingBuffer> buffer;
+    if (!buffer)
+      buffer = addBuffer();
+    return *buffer;
+  }
+  std::shared_ptr<logDetail::StagingBuffer> addBuffer();
+  void run();
+  // Write out the staged records in the order of their time, under mtx_
+  void drain();
+  // Calibrate the ticks against the system time, under mtx_
+  void calibrate();
+
+  std::atomic<LogLevel> level_{LogLevel::info};
+  std::mutex mtx_;
+  std::condition_variable wake_;
+  // Buffers of the threads that logged. Kept after the thread exits until
+  // the records are written out.
+  std::vector<std::shared_ptr<logDetail::StagingBuffer>> buffers_;
+  std::ostream *out_; // Under mtx_
+  std::ostream *err_; // Under mtx_
+  bool stop_ = false; // Under mtx_
+  // Under mtx_: system time, ns, at calTicks_ and the tick length between
+  // the last two calibrations
+  int64_t calTicks_ = 0;
+  int64_t calTime_ = 0;
+  double nsPerTick_ = 1;
+  std::thread thread_;
+};
+
+template <typename... Args> void logDebug(const Args &...args) {
+  Logger::instance().write(LogLevel::debug, args...);
+}
+template <typename... Args> void logInfo(const Args &...args) {
+  Logger::instance().write(LogLevel::info, args...);
+}
+template <typename... Args> void logWarning(const Args &...args) {
+  Logger::instance().write(LogLevel::warning, args...);
+}
+template <typename... Args> void logError(const Args &...args) {
+  Logger::instance().write(LogLevel::error, args...);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Messages handed to a session by other threads, taken by its strand.
+//
+// push() appends to a vector under a short lock. It returns true when the
+// inbox was empty, and only then does the caller post a drain to the strand;
+// the messages pushed until the drain runs ride on the same wakeup. drain()
+// swaps the vector for a spare one under the lock and hands the messages
+// over in the order they were pushed. The two vectors keep their capacity,
+// so once they have grown neither side allocates.
+template <typename T> class SendInbox {
+public:
+  SendInbox() = default;
+  SendInbox(const SendInbox &) = delete;
+  SendInbox &operator=(const SendInbox &) = delete;
+
+  // Returns true if the inbox was empty: a drain must be scheduled
+  bool push(T value) {
+    std::lock_guard lock{mtx_};
+    items_.push_back(std::move(value));
+    return items_.size() == 1;
+  }
+
+  // onMessage(T &&) for every message pushed so far, oldest first. Called
+  // by one thread at a time.
+  template <typename OnMessage> void drain(OnMessage onMessage) {
+    {
+      std::lock_guard lock{mtx_};
+      items_.swap(taken_);
+    }
+    for (auto &item : taken_)
+      onMessage(std::move(item));
+    taken_.clear();
+  }
+
+private:
+  std::mutex mtx_;
+  std::vector<T> items_; // Under mtx_
+  std::vector<T> taken_; // Owned by the draining thread
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "../device_emulator/helpers/framePayload.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// What a session does when its client reads slower than the frames arrive
+enum class SlowClientPolicy {
+  dropOldest, // the oldest waiting frame gives way to the new one
+  dropNewest, // the new frame is dropped
+  disconnect, // the new frame is dropped; after slowTimeout of a full
+              // queue the client is disconnected
+  coalesce    // a waiting frame with the code of the new one is replaced in
+              // place, so only the latest frame of each chart waits; when
+              // full, as dropOldest
+};
+
+struct ISendQueueConfig {
+  size_t capacity = 256; // Сообщений в очереди сессии
+  SlowClientPolicy policy = SlowClientPolicy::dropOldest;
+  double slowTimeout = 10; // Секунд с заполненной очередью до отключения
+};
+
+// Set at startup from the server options
+extern ISendQueueConfig sendQueueConfig;
+
+struct ISendQueueStats {
+  size_t queued = 0;            // Сообщений в очереди, включая отправляемое
+  uint64_t queuedBytes = 0;     // Байт в очереди
+  uint64_t droppedFrames = 0;   // Отброшено бинарных сообщений
+  uint64_t coalescedFrames = 0; // Заменено более новыми того же кода
+};
+
+// Wait of the text messages from send() to the start of their write
+struct IControlWaitStats {
+  uint64_t messages = 0; // Начато отправок текстовых сообщений
+  double meanMs = 0;     // Среднее ожидание, мс
+  double maxMs = 0;      // Максимальное ожидание, мс
+};
+
+struct IQueueMsg {
+  IGatherMessage message;
+  bool isText = false;
+  std::chrono::steady_clock::time_point sentAt{}; // Текст: время send()
+  uint64_t logSeq = 0; // deviceLog: номер последней записи сообщения
+};
+
+// Code of a binary message: its first byte
+inline uint8_t messageCode(const IGatherMessage &message) {
+  auto &buffers = message.buffers;
+  return buffers.empty() || !buffers.front().size()
+             ? 0
+             : *static_cast<const uint8_t *>(buffers.front().data());
+}
+
+// Fixed-capacity ring of the messages waiting to be written to a client.
+// Once its write has started, the front message is never dropped or moved.
+// Text messages carry the device state and are not dropped either: when the
+// ring is full, a frame makes room for them. They form a priority lane: a
+// text message is queued ahead of the waiting frames, behind the text
+// messages already waiting, so it is written at the next frame boundary and
+// the text messages keep their order in every policy.
+class SendQueue {
+public:
+  using clock = std::chrono::steady_clock;
+
+  enum class Push {
+    queued,  // the message was added
+    dropped, // the message was dropped by the policy
+    overflow // no frame to drop for a text message, the client must go
+  };
+
+  explicit SendQueue(const ISendQueueConfig &config)
+      : config_{config}, slots_(std::max<size_t>(config.capacity, 2)) {}
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  const IQueueMsg &front() const { return slots_[head_]; }
+  // The front message is being written
+  bool writing() const { return writing_; }
+
+  // Called when the write of the front message starts. The wait of a text
+  // message ends there.
+  void writeStarted(clock::time_point now) {
+    writing_ = true;
+    if (!front().isText)
+      return;
+    auto waitNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - front().sentAt)
+            .count());
+    controlMessages_.fetch_add(1, std::memory_order_relaxed);
+    controlWaitSumNs_.fetch_add(waitNs, std::memory_order_relaxed);
+    if (waitNs > controlWaitMaxNs_.load(std::memory_order_relaxed))
+      controlWaitMaxNs_.store(waitNs, std::memory_order_relaxed);
+  }
+
+  // Remove the written front message
+  void pop() {
+    writing_ = false;
+    queuedBytes_ -= slots_[head_].message.size();
+    slots_[head_] = IQueueMsg{};
+    head_ = (head_ + 1) % slots_.size();
+    size_--;
+    // The client caught up
+    if (size_ <= slots_.size() / 2)
+      behindSince_.reset();
+  }
+
+  Push push(IQueueMsg msg, clock::time_point now) {
+    if (config_.policy == SlowClientPolicy::coalesce && !msg.isText) {
+      size_t frame = waitingFrame(messageCode(msg.message));
+      if (frame < size_) {
+        queuedBytes_ += msg.message.size();
+        queuedBytes_ -= at(frame).message.size();
+        at(frame) = std::move(msg);
+        coalescedFrames_++;
+        return Push::queued;
+      }
+    }
+    if (size_ == slots_.size()) {
+      if (!behindSince_)
+        behindSince_ = now;
+      bool dropNew = config_.policy == SlowClientPolicy::dropNewest ||
+                     config_.policy == SlowClientPolicy::disconnect;
+      if (dropNew && !msg.isText) {
+        droppedFrames_++;
+        return Push::dropped;
+      }
+      size_t frame = oldestWaitingFrame();
+      if (frame == size_) {
+        if (msg.isText)
+          return Push::overflow;
+        droppedFrames_++;
+        return Push::dropped;
+      }
+      erase(frame);
+      droppedFrames_++;
+    }
+    queuedBytes_ += msg.message.size();
+    size_t index = size_;
+    if (msg.isText) {
+      index = oldestWaitingFrame();
+      for (size_t i = size_; i > index; i--)
+        at(i) = std::move(at(i - 1));
+    }
+    at(index) = std::move(msg);
+    size_++;
+    return Push::queued;
+  }
+
+  // The disconnect policy gives up on a client whose queue has stayed full
+  // for slowTimeout
+  bool tooSlow(clock::time_point now) const {
+    return config_.policy == SlowClientPolicy::disconnect && behindSince_ &&
+           std::chrono::duration<double>(now - *behindSince_).count() >=
+               config_.slowTimeout;
+  }
+
+  ISendQueueStats stats() const {
+    ISendQueueStats stats;
+    stats.queued = size_;
+    stats.queuedBytes = queuedBytes_;
+    stats.droppedFrames = droppedFrames_;
+    stats.coalescedFrames = coalescedFrames_;
+    return stats;
+  }
+
+  // May be called from any thread
+  IControlWaitStats controlWait() const {
+    IControlWaitStats stats;
+    stats.messages = controlMessages_.load(std::memory_order_relaxed);
+    auto sumNs = controlWaitSumNs_.load(std::memory_order_relaxed);
+    auto maxNs = controlWaitMaxNs_.load(std::memory_order_relaxed);
+    if (stats.messages) {
+      stats.meanMs = static_cast<double>(sumNs) /
+                     static_cast<double>(stats.messages) / 1e6;
+    }
+    stats.maxMs = static_cast<double>(maxNs) / 1e6;
+    return stats;
+  }
+
+private:
+  IQueueMsg &at(size_t index) {
+    return slots_[(head_ + index) % slots_.size()];
+  }
+
+  // Index of the first message not being written
+  size_t firstWaiting() const { return writing_ ? 1 : 0; }
+
+  // Index of the oldest waiting binary message, size_ if none
+  size_t oldestWaitingFrame() {
+    for (size_t i = firstWaiting(); i < size_; i++) {
+      if (!at(i).isText)
+        return i;
+    }
+    return size_;
+  }
+
+  // Index of the waiting binary message with `code`, size_ if none
+  size_t waitingFrame(uint8_t code) {
+    for (size_t i = firstWaiting(); i < size_; i++) {
+      if (!at(i).isText && messageCode(at(i).message) == code)
+        return i;
+    }
+    return size_;
+  }
+
+  void erase(size_t index) {
+    queuedBytes_ -= at(index).message.size();
+    for (size_t i = index; i + 1 < size_; i++)
+      at(i) = std::move(at(i + 1));
+    at(size_ - 1) = IQueueMsg{};
+    size_--;
+  }
+
+  ISendQueueConfig config_;
+  std::vector<IQueueMsg> slots_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  bool writing_ = false;
+  uint64_t queuedBytes_ = 0;
+  uint64_t droppedFrames_ = 0;
+  uint64_t coalescedFrames_ = 0;
+  // Written by the owner only, read by controlWait()
+  std::atomic<uint64_t> controlMessages_{0};
+  std::atomic<uint64_t> controlWaitSumNs_{0};
+  std::atomic<uint64_t> controlWaitMaxNs_{0};
+  // Since when the ring is full, reset once it is half empty
+  std::optional<clock::time_point> behindSince_;
+};
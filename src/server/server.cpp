@@ -79,5 +79,5 @@ std::string path_cat(beast::string_view base, beast::string_view path) {
 
 // Report a failure
 void fail(beast::error_code ec, char const *what) {
-  std::cerr << what << ": " << ec.message() << "\n";
+  logError(what, ": ", ec.message());
 }
\ No newline at end of file
@@ -15,8 +15,12 @@
 //------------------------------------------------------------------------------
 
 #include "../device_emulator/device_emulator.hpp"
+#include "../device_emulator/helpers/framePayload.h"
 #include "../device_emulator/interfaces/IJsonMsg.h"
-#include "clientList.h"
+#include "compressionPolicy.h"
+#include "logger.h"
+#include "sendInbox.h"
+#include "sendQueue.h"
 #include <algorithm>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/asio/bind_executor.hpp>
@@ -45,6 +49,7 @@
 #include <queue>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
@@ -165,40 +170,42 @@ void fail(beast::error_code ec, char const *what);
 // Echoes back all received WebSocket messages
 class websocket_session
     : public std::enable_shared_from_this<websocket_session> {
-public:
-  struct IQueueMsg {
-    IQueueMsg(std::shared_ptr<std::vector<char>> &data, size_t size,
-              bool isText)
-        : data_{data}, size_{size}, isText_{isText} {};
-    std::shared_ptr<std::vector<char>> data_;
-    size_t size_;
-    bool isText_;
-  };
-
-private:
   websocket::stream<beast::tcp_stream> ws_;
   beast::flat_buffer buffer_;
-  std::vector<IQueueMsg> queue_;
-  std::mutex mtx_;
-  std::string cid_; // Client ID
+  SendInbox<IQueueMsg> inbox_;       // From any thread to the strand
+  std::atomic<size_t> inboxed_{0};   // Messages in inbox_
+  SendQueue queue_{sendQueueConfig}; // On the strand
+  std::atomic<size_t> queueSize_{0}; // queue_.size() for the other threads
+  bool closing_ = false;             // On the strand, the client is too slow
+  std::string cid_;                  // Client ID
+  DevEmulator &device_;              // Device selected by the URL path
+  Seqlock<IChartState> chartState_;  // Read by the frames of device_
+  uint64_t logSince_;                // Last log entry the client has
+  uint64_t logSeq_ = 0;              // On the strand, last log entry sent
 
 public:
-  // Take ownership of the socket
-  explicit websocket_session(tcp::socket &&socket) : ws_(std::move(socket)) {
+  // Take ownership of the socket. The options come from the query string of
+  // the URL.
+  websocket_session(tcp::socket &&socket, DevEmulator &device,
+                    const IConnectOptions &options)
+      : ws_(std::move(socket)), device_(device), logSince_(options.logSince) {
     cid_ = boost::uuids::to_string(boost::uuids::random_generator()());
-    IClient client;
-    client.ws = this;
-    clientList.push_back(client);
-    std::cout << "Create websocket_session: " << cid_ << "\n";
+    if (options.batch) {
+      IChartState chartState;
+      chartState.batch = true;
+      chartState_.store(chartState);
+    }
+    logInfo("Create websocket_session: ", cid_);
   }
 
   ~websocket_session() {
-    clientList.erase(std::remove_if(clientList.begin(), clientList.end(),
-                                    [this](const IClient &client) {
-                                      return client.ws == this;
-                                    }),
-                     clientList.end());
-    std::cout << "Delete websocket_session " << cid_ << "\n";
+    device_.removeClient();
+    auto stats = queue_.stats();
+    auto wait = queue_.controlWait();
+    logInfo("Delete websocket_session ", cid_, ": dropped frames ",
+            stats.droppedFrames, ", coalesced ", stats.coalescedFrames,
+            ", text messages ", wait.messages, ", wait mean ", wait.meanMs,
+            " ms, max ", wait.maxMs, " ms");
   };
 
   // Start the asynchronous accept operation
@@ -215,20 +222,70 @@ public:
                   std::string(BOOST_BEAST_VERSION_STRING) + "advanced-server");
         }));
 
+    // Accept permessage-deflate if the client offers it
+    if (compressionPolicy == CompressionPolicy::all) {
+      websocket::permessage_deflate deflate;
+      deflate.server_enable = true;
+      ws_.set_option(deflate);
+    }
+
     // Accept the websocket handshake
     ws_.async_accept(req,
                      beast::bind_front_handler(&websocket_session::on_accept,
                                                shared_from_this()));
   }
 
-  void send(std::shared_ptr<std::vector<char>> &data, size_t size,
-            bool isText) {
-    std::lock_guard lock{mtx_};
-    queue_.emplace_back(data, size, isText);
-    //    std::cout << cid_ << " Size queue: " << queue_.size() << "\n";
+  void send(const IBuffer &data, size_t size, bool isText) {
+    send(makeGatherMessage(data, size), isText);
+  }
+
+  // May be called from any thread. The message goes to the inbox under a
+  // short lock; the first message of an empty inbox posts a drain to the
+  // strand of the session, which queues everything sent until then in one
+  // go. The queue and the writes are touched only on the strand. The
+  // buffers are written as they are, without joining them. When the client
+  // falls behind, the queue policy drops or coalesces the frames, or
+  // disconnects the client. Text messages go ahead of the waiting frames.
+  // A deviceLog message carries the sequence number of its last entry and is
+  // dropped if the connect snapshot of the session already has it.
+  void send(const IGatherMessage &message, bool isText, uint64_t logSeq = 0) {
+    IQueueMsg msg{message, isText};
+    if (isText)
+      msg.sentAt = SendQueue::clock::now();
+    msg.logSeq = logSeq;
+    inboxed_.fetch_add(1, std::memory_order_relaxed);
+    if (inbox_.push(std::move(msg)))
+      net::post(ws_.get_executor(),
+                beast::bind_front_handler(&websocket_session::on_inbox,
+                                          shared_from_this()));
+  }
+
+  // Chart state of the client, read by the frames
+  const Seqlock<IChartState> &chartState() const { return chartState_; }
 
-    // Are we already writing?
-    if (queue_.size() == 1)
+  // Number of messages waiting to be written, may be called from any thread
+  size_t queued() const {
+    return inboxed_.load(std::memory_order_relaxed) +
+           queueSize_.load(std::memory_order_relaxed);
+  }
+
+  // Wait of the text messages so far, may be called from any thread
+  IControlWaitStats controlWait() const { return queue_.controlWait(); }
+
+  // Queue the connect snapshot ahead of everything sent to the session so
+  // far. `logSeq` is the last log entry in it. Called on the strand, before
+  // the inbox is drained.
+  void sendConnect(const IBuffer &state, const IBuffer &deviceLog,
+                   uint64_t logSeq) {
+    auto now = SendQueue::clock::now();
+    for (auto &data : {state, deviceLog}) {
+      IQueueMsg msg{makeGatherMessage(data, data->size()), true};
+      msg.sentAt = now;
+      queue_.push(std::move(msg), now);
+    }
+    queueSize_.store(queue_.size(), std::memory_order_relaxed);
+    logSeq_ = logSeq;
+    if (!queue_.writing())
       do_write();
   }
 
@@ -237,15 +294,9 @@ private:
     if (ec)
       return fail(ec, "websocket_session accept");
 
-    // Send state of emulator on opening websocket_session
-    json msg = json{
-        {"deviceState", emulator.getDeviceState()},
-        {"deviceLog", emulator.getDeviceLog()},
-        {"chartAxisLimits", emulator.getChartAxisLimits()},
-    };
-    auto str = msg.dump();
-    auto buff = std::make_shared<std::vector<char>>(str.begin(), str.end());
-    send(buff, buff->size(), true);
+    // Send state of emulator on opening websocket_session, then the frames
+    // and the broadcasts
+    device_.connectClient(shared_from_this(), logSince_);
 
     // Start read messages
     do_read();
@@ -271,11 +322,23 @@ private:
     }
 
     if (bytes_transferred) {
-      auto req = json::parse(beast::buffers_to_string(buffer_.data()));
-      if (req.contains("deviceState"))
-        emulator.setDeviceState(req.at("deviceState"));
-      if (req.contains("chartState"))
-        emulator.setChartState(req.at("chartState"), this);
+      // Parsed in place; the chart state is written only by this session
+      auto data = static_cast<const char *>(buffer_.data().data());
+      IControlMsg msg;
+      auto chartState = chartState_.load();
+      std::string error;
+      if (!parseControlMsg(data, buffer_.size(), msg, chartState, error)) {
+        logWarning("websocket_session ", cid_, ": Ошибка в запросе: ", error);
+      } else {
+        if (msg.hasChartState) {
+          logInfo("websocket_session ", cid_,
+                  ": Получено новое состояние графиков: ",
+                  std::string_view{data, buffer_.size()});
+          chartState_.store(chartState);
+        }
+        if (msg.hasDeviceState)
+          device_.setDeviceState(msg.deviceState);
+      }
     }
 
     // Clear the buffer
@@ -285,12 +348,44 @@ private:
     do_read();
   }
 
+  // Move the sent messages to the write queue and start writing if idle
+  void on_inbox() {
+    size_t taken = 0;
+    auto now = SendQueue::clock::now();
+    inbox_.drain([&](IQueueMsg &&msg) {
+      taken++;
+      if (closing_ || (msg.logSeq && msg.logSeq <= logSeq_))
+        return;
+      auto pushed = queue_.push(std::move(msg), now);
+      if (pushed == SendQueue::Push::overflow || queue_.tooSlow(now))
+        disconnectSlow();
+    });
+    inboxed_.fetch_sub(taken, std::memory_order_relaxed);
+    queueSize_.store(queue_.size(), std::memory_order_relaxed);
+
+    if (!queue_.writing() && !closing_)
+      do_write();
+  }
+
+  // Close the socket of a client that does not keep up. The pending
+  // operations fail and release the session.
+  void disconnectSlow() {
+    closing_ = true;
+    auto stats = queue_.stats();
+    logWarning("websocket_session ", cid_, ": the client is too slow, ",
+               stats.queued, " messages of ", stats.queuedBytes,
+               " bytes queued, disconnecting");
+    beast::error_code ec;
+    beast::get_lowest_layer(ws_).socket().close(ec);
+  }
+
   void do_write() {
     // Send the next message if any
     if (!queue_.empty()) {
-      auto msg = queue_.front();
-      ws_.text(msg.isText_);
-      ws_.async_write(net::buffer(*msg.data_, msg.size_),
+      queue_.writeStarted(SendQueue::clock::now());
+      auto &msg = queue_.front();
+      ws_.text(msg.isText);
+      ws_.async_write(msg.message.buffers,
                       beast::bind_front_handler(&websocket_session::on_write,
                                                 shared_from_this()));
     }
@@ -298,16 +393,14 @@ private:
 
   void on_write(beast::error_code ec, std::size_t bytes_transferred) {
     boost::ignore_unused(bytes_transferred);
-    std::lock_guard lock{mtx_};
 
     if (ec)
       return fail(ec, "websocket_session write");
 
-    // Remove the message from the queue
-    queue_.erase(queue_.begin());
-    //    std::cout << cid_ << " Size queue: " << queue_.size() << "\n";
-
-    //    std::this_thread::sleep_for(std::chrono::seconds(1));
+    // Remove the message from the queue and write the next one right away:
+    // the messages queued meanwhile go out back-to-back on this wakeup
+    queue_.pop();
+    queueSize_.store(queue_.size(), std::memory_order_relaxed);
 
     do_write();
   }
@@ -334,10 +427,10 @@ public:
                std::shared_ptr<std::string const> const &doc_root)
       : stream_(std::move(socket)), doc_root_(doc_root) {
     static_assert(queue_limit > 0, "queue limit must be positive");
-    std::cout << "Create http_session \n";
+    logDebug("Create http_session");
   }
 
-  ~http_session() { std::cout << "Delete http_session \n"; };
+  ~http_session() { logDebug("Delete http_session"); };
 
   // Start the session
   void run() {
@@ -380,9 +473,25 @@ private:
 
     // See if it is a WebSocket Upgrade
     if (websocket::is_upgrade(parser_->get())) {
+      auto const target = parser_->get().target();
+      auto device = findDevice({target.data(), target.size()});
+      if (!device) {
+        // Refuse the upgrade to an unknown device
+        http::response<http::string_body> res{http::status::not_found,
+                                              parser_->get().version()};
+        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        res.set(http::field::content_type, "text/html");
+        res.keep_alive(false);
+        res.body() = "The device '" + std::string(target) + "' was not found.";
+        res.prepare_payload();
+        return queue_write(std::move(res));
+      }
+
       // Create a websocket session, transferring ownership
       // of both the socket and the HTTP request.
-      std::make_shared<websocket_session>(stream_.release_socket())
+      auto options = parseConnectOptions({target.data(), target.size()});
+      std::make_shared<websocket_session>(stream_.release_socket(), *device,
+                                          options)
           ->do_accept(parser_->release());
 
       return;
@@ -0,0 +1,199 @@
+#include "serverOptions.h"
+#include <stdexcept>
+
+namespace {
+
+bool parseUint64(const std::string &value, uint64_t &result) {
+  try {
+    size_t pos = 0;
+    result = std::stoull(value, &pos, 0);
+    return pos == value.size();
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool parseFloat(const std::string &value, float &result) {
+  try {
+    size_t pos = 0;
+    result = std::stof(value, &pos);
+    return pos == value.size();
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool parseDouble(const std::string &value, double &result) {
+  try {
+    size_t pos = 0;
+    result = std::stod(value, &pos);
+    return pos == value.size();
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool parseOverrun(const std::string &value, OverrunPolicy &policy) {
+  if (value == "catch-up")
+    policy = OverrunPolicy::catchUp;
+  else if (value == "skip")
+    policy = OverrunPolicy::skip;
+  else
+    return false;
+  return true;
+}
+
+bool parseCompression(const std::string &value, CompressionPolicy &policy) {
+  if (value == "off")
+    policy = CompressionPolicy::off;
+  else if (value == "all")
+    policy = CompressionPolicy::all;
+  else
+    return false;
+  return true;
+}
+
+bool parseSlowClient(const std::string &value, SlowClientPolicy &policy) {
+  if (value == "drop-oldest")
+    policy = SlowClientPolicy::dropOldest;
+  else if (value == "drop-newest")
+    policy = SlowClientPolicy::dropNewest;
+  else if (value == "disconnect")
+    policy = SlowClientPolicy::disconnect;
+  else if (value == "coalesce")
+    policy = SlowClientPolicy::coalesce;
+  else
+    return false;
+  return true;
+}
+
+// "<freqOffset>:<level>"
+bool parseTone(const std::string &value, ITone &tone) {
+  auto colon = value.find(':');
+  return colon != std::string::npos &&
+         parseFloat(value.substr(0, colon), tone.freqOffset) &&
+         parseFloat(value.substr(colon + 1), tone.level);
+}
+
+} // namespace
+
+bool parseServerOptions(int argc, char *argv[], IServerOptions &options,
+                        std::string &error) {
+  bool defaultTones = true;
+  for (int i = 0; i < argc; i++) {
+    std::string arg{argv[i]};
+    auto eq = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+      error = "Malformed option '" + arg + "'";
+      return false;
+    }
+    auto name = arg.substr(2, eq - 2);
+    auto value = arg.substr(eq + 1);
+
+    bool ok = false;
+    if (name == "seed") {
+      ok = parseUint64(value, options.seed);
+      options.hasSeed = ok;
+    } else if (name == "devices") {
+      ok = parseUint64(value, options.devices) && options.devices >= 1 &&
+           options.devices <= 1024;
+    } else if (name == "tone") {
+      // The first --tone replaces the default tones
+      if (defaultTones)
+        options.signal.tones.clear();
+      defaultTones = false;
+      ITone tone;
+      ok = parseTone(value, tone);
+      options.signal.tones.push_back(tone);
+    } else if (name == "noise") {
+      ok = parseFloat(value, options.signal.noiseLevel);
+    } else if (name == "chan1-phase") {
+      ok = parseFloat(value, options.signal.chan1Phase);
+    } else if (name == "cross-avg") {
+      ok = parseFloat(value, options.signal.crossAveraging) &&
+           options.signal.crossAveraging > 0 &&
+           options.signal.crossAveraging <= 1;
+    } else if (name == "record") {
+      options.record = value;
+      ok = !value.empty();
+    } else if (name == "replay") {
+      options.replay = value;
+      ok = !value.empty();
+    } else if (name == "replay-speed") {
+      ok = parseDouble(value, options.replaySpeed) && options.replaySpeed >= 0;
+    } else if (name == "rate") {
+      ok = parseDouble(value, options.scheduler.rate) &&
+           options.scheduler.rate >= 0.1 && options.scheduler.rate <= 10000;
+    } else if (name == "overrun") {
+      ok = parseOverrun(value, options.scheduler.overrun);
+    } else if (name == "log-capacity") {
+      ok = parseUint64(value, options.logCapacity) &&
+           options.logCapacity >= 1 && options.logCapacity <= 1000000;
+    } else if (name == "send-queue") {
+      uint64_t capacity = 0;
+      ok = parseUint64(value, capacity) && capacity >= 2 && capacity <= 65536;
+      options.sendQueue.capacity = capacity;
+    } else if (name == "slow-client") {
+      ok = parseSlowClient(value, options.sendQueue.policy);
+    } else if (name == "slow-timeout") {
+      ok = parseDouble(value, options.sendQueue.slowTimeout) &&
+           options.sendQueue.slowTimeout > 0;
+    } else if (name == "log-level") {
+      ok = parseLogLevel(value, options.logLevel);
+    } else if (name == "deflate") {
+      // Beast deflates every message of a stream or none of them
+      if (value == "text" || value == "spectra") {
+        error = "Option '" + arg +
+                "': per-kind compression is not supported, use off or all";
+        return false;
+      }
+      ok = parseCompression(value, options.compression);
+    } else {
+      error = "Unknown option '" + arg + "'";
+      return false;
+    }
+
+    if (!ok) {
+      error = "Invalid value in option '" + arg + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+const char *serverOptionsUsage() {
+  return "Options:\n"
+         "    --devices=<n>         number of emulated devices, 1 to 1024;\n"
+         "                          clients select one by the URL path\n"
+         "                          /device/<index>, / is device 0\n"
+         "    --seed=<n>            deterministic seed of the emulated data\n"
+         "    --tone=<Hz>:<dBFS>    tone offset from freqCenter and level,\n"
+         "                          repeat for several tones\n"
+         "    --noise=<dBFS>        noise level\n"
+         "    --chan1-phase=<deg>   phase shift of the tones in channel 1\n"
+         "    --cross-avg=<alpha>   cross spectrum averaging, (0, 1], 1 = off\n"
+         "    --rate=<Hz>           frame rate, 0.1 to 10000, default 2\n"
+         "    --overrun=<policy>    late frames: catch-up (default) or skip\n"
+         "    --deflate=<policy>    permessage-deflate: off (default) or all,\n"
+         "                          which compresses every message of a\n"
+         "                          client that accepts it\n"
+         "    --send-queue=<n>      messages queued for a client, 2 to 65536,\n"
+         "                          default 256\n"
+         "    --slow-client=<policy>\n"
+         "                          when the queue of a client is full:\n"
+         "                          drop-oldest (default) or drop-newest\n"
+         "                          frame, or disconnect after the timeout;\n"
+         "                          coalesce keeps only the latest waiting\n"
+         "                          frame of each chart\n"
+         "    --slow-timeout=<s>    seconds of a full queue before the\n"
+         "                          disconnect, default 10\n"
+         "    --log-capacity=<n>    device log entries kept for reconnecting\n"
+         "                          clients, 1 to 1000000, default 256\n"
+         "    --log-level=<level>   debug, info (default), warning or error\n"
+         "    --record=<path>       record the messages of device 0 to <path>\n"
+         "                          and the index to <path>.idx\n"
+         "    --replay=<path>       stream a recorded capture to the clients\n"
+         "                          instead of generating frames\n"
+         "    --replay-speed=<x>    replay speed, default 1, 0 is as fast as\n"
+         "                          the clients take the messages\n";
+}
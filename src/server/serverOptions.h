@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../device_emulator/dsp/signalEngine.h"
+#include "../device_emulator/frameScheduler.h"
+#include "compressionPolicy.h"
+#include "logger.h"
+#include "sendQueue.h"
+#include <cstdint>
+#include <string>
+
+// Optional "--name=value" arguments following the positional ones
+struct IServerOptions {
+  bool hasSeed = false;
+  uint64_t seed = 0;          // Seed of the emulated data generators
+  uint64_t devices = 1;       // Number of emulated devices
+  std::string record;         // Capture of the messages of device 0
+  std::string replay;         // Capture replayed by every device
+  double replaySpeed = 1;     // 0 - as fast as possible
+  uint64_t logCapacity = 256; // Device log entries kept by each device
+  ISignalConfig signal;
+  ISchedulerConfig scheduler;
+  CompressionPolicy compression = CompressionPolicy::off;
+  LogLevel logLevel = LogLevel::info;
+  ISendQueueConfig sendQueue;
+};
+
+// Returns false and fills `error` on an unknown or malformed option
+bool parseServerOptions(int argc, char *argv[], IServerOptions &options,
+                        std::string &error);
+
+// Help text for the options
+const char *serverOptionsUsage();